@@ -0,0 +1,145 @@
+#include "board.h"
+#include "mw.h"
+
+// Relay feedback autotune, BOXAUTOTUNE while armed.
+// ROLL and then PITCH get a bang-bang output of +-autotune_relay instead of their PID, switched on the sign of
+// gyroData with a little hysteresis. That settles into a limit cycle at the ultimate period Tu, and from its
+// amplitude a the ultimate gain is Ku = 4 * relay / (pi * a). autotune_rule turns Ku/Tu into P/I/D in MultiWii
+// P8/I8/D8 units. The candidates only go to cfg when confirmed with "autotune apply" in the CLI.
+
+#define AUTOTUNE_HYSTERESIS     8       // gyroData LSB, ~2deg/s
+#define AUTOTUNE_SKIP_CYCLES    2       // let the oscillation settle first
+#define AUTOTUNE_CYCLES         6       // then average this many
+#define AUTOTUNE_TIMEOUT        5000000 // us per axis
+#define AUTOTUNE_MAX_ANGLE      300     // 0.1deg, give up beyond 30deg of tilt
+
+autotune_t autotune;
+
+static int8_t relay;                // current relay direction
+static int16_t peakHigh, peakLow;   // gyroData extremes in this cycle
+static uint8_t relayCycles;
+static uint32_t cycleStart, axisStart;
+static float amplitudeSum, periodSum;
+static uint32_t cycleTimeSum, loops;
+
+// Ziegler-Nichols style rules: Kp = kp * Ku, Ti = ti * Tu, Td = td * Tu
+static const float autotuneRules[][3] = {
+    { 0.60f, 0.50f, 0.125f },       // 0: classic Ziegler-Nichols
+    { 0.33f, 0.50f, 0.33f },        // 1: some overshoot
+    { 0.20f, 0.50f, 0.33f },        // 2: no overshoot
+};
+
+// Ku in axisPID per gyroData LSB, Tu and dt (loop time) in seconds. Same scaling as the MultiWii PID:
+// PTerm = gyro * P8 / 80, ITerm = sum(error) / 125 * I8 / 64 per loop, DTerm = 3 sample delta * D8 / 32.
+void autotuneComputeGains(float ku, float tu, float dt, uint8_t rule, uint8_t *p, uint8_t *i, uint8_t *d)
+{
+    float kp = autotuneRules[rule][0] * ku;
+    float ti = autotuneRules[rule][1] * tu;
+    float td = autotuneRules[rule][2] * tu;
+
+    *p = constrain(kp * 80.0f + 0.5f, 0, 200);
+    *i = constrain(kp / ti * 8000.0f * dt + 0.5f, 0, 200);
+    *d = constrain(kp * td * 32.0f / (3.0f * dt) + 0.5f, 0, 200);
+}
+
+static void autotuneStartAxis(uint8_t axis)
+{
+    autotune.axis = axis;
+    autotune.state = AUTOTUNE_RUNNING;
+    relay = 1;
+    peakHigh = peakLow = 0;
+    relayCycles = 0;
+    amplitudeSum = periodSum = 0.0f;
+    cycleTimeSum = loops = 0;
+    axisStart = cycleStart = micros();
+}
+
+static void autotuneFinishAxis(void)
+{
+    uint8_t axis = autotune.axis;
+    float amplitude = amplitudeSum / AUTOTUNE_CYCLES;
+
+    autotune.ku[axis] = 4.0f * cfg.autotune_relay / (M_PI * amplitude);
+    autotune.tu[axis] = periodSum / AUTOTUNE_CYCLES;
+    autotuneComputeGains(autotune.ku[axis], autotune.tu[axis], cycleTimeSum * 1e-6f / loops, cfg.autotune_rule,
+        &autotune.P8[axis], &autotune.I8[axis], &autotune.D8[axis]);
+    autotune.done |= 1 << axis;
+
+    // integrators wound up while the relay had the axis
+    pidResetIntegrals();
+    if (axis == ROLL)
+        autotuneStartAxis(PITCH);
+    else
+        autotune.state = AUTOTUNE_IDLE;
+}
+
+// Runs after the PID controller every loop and takes over axisPID of the axis under test.
+void autotuneUpdate(void)
+{
+    int16_t gyro;
+    uint32_t now;
+
+    if (!rcOptions[BOXAUTOTUNE] || !f.ARMED) {
+        if (autotune.state == AUTOTUNE_RUNNING)
+            pidResetIntegrals();
+        autotune.state = AUTOTUNE_IDLE;
+        autotune.ready = !rcOptions[BOXAUTOTUNE];   // a new run needs the box switched off and on again
+        return;
+    }
+    if (autotune.ready) {
+        autotune.ready = 0;
+        autotuneStartAxis(ROLL);
+    }
+    if (autotune.state != AUTOTUNE_RUNNING)
+        return;
+
+    now = micros();
+    gyro = gyroData[autotune.axis];
+    if ((sensors(SENSOR_ACC) && abs(angle[autotune.axis]) > AUTOTUNE_MAX_ANGLE) || now - axisStart > AUTOTUNE_TIMEOUT) {
+        pidResetIntegrals();
+        autotune.state = AUTOTUNE_FAILED;
+        return;
+    }
+
+    peakHigh = max(peakHigh, gyro);
+    peakLow = min(peakLow, gyro);
+    cycleTimeSum += cycleTime;
+    loops++;
+
+    if (relay > 0 && gyro > AUTOTUNE_HYSTERESIS) {
+        relay = -1;
+    } else if (relay < 0 && gyro < -AUTOTUNE_HYSTERESIS) {
+        // one full cycle from switch to positive to the next
+        relay = 1;
+        if (++relayCycles > AUTOTUNE_SKIP_CYCLES) {
+            amplitudeSum += (peakHigh - peakLow) / 2.0f;
+            periodSum += (now - cycleStart) * 1e-6f;
+        }
+        peakHigh = peakLow = 0;
+        cycleStart = now;
+        if (relayCycles == AUTOTUNE_SKIP_CYCLES + AUTOTUNE_CYCLES) {
+            autotuneFinishAxis();
+            return;
+        }
+    }
+
+    axisPID[autotune.axis] = relay * cfg.autotune_relay;
+}
+
+// Copy the candidate gains of every tuned axis into cfg, still needs a save.
+bool autotuneApply(void)
+{
+    uint8_t axis;
+
+    if (!autotune.done)
+        return false;
+    for (axis = ROLL; axis <= PITCH; axis++) {
+        if (!(autotune.done & (1 << axis)))
+            continue;
+        cfg.P8[axis] = autotune.P8[axis];
+        cfg.I8[axis] = autotune.I8[axis];
+        cfg.D8[axis] = autotune.D8[axis];
+    }
+    autotune.done = 0;
+    return true;
+}
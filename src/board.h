@@ -49,6 +49,11 @@ typedef enum {
     FEATURE_SONAR = 1 << 10,
     FEATURE_TELEMETRY = 1 << 11,
     FEATURE_POWERMETER = 1 << 12,
+    FEATURE_ONESHOT125 = 1 << 13,
+    FEATURE_DSHOT = 1 << 14,
+    FEATURE_SBUS = 1 << 15,
+    FEATURE_RX_MSP = 1 << 16,
+    FEATURE_VBAT_COMP = 1 << 17,
 } AvailableFeatures;
 
 typedef enum {
@@ -60,7 +65,9 @@ typedef enum {
 typedef void (* sensorInitFuncPtr)(void);                   // sensor init prototype
 typedef void (* sensorReadFuncPtr)(int16_t *data);          // sensor read and align prototype
 typedef int32_t (* baroCalculateFuncPtr)(void);             // baro calculation (returns altitude in cm based on static data collected)
+typedef bool (* baroReadyFuncPtr)(void);                    // baro end of conversion check
 typedef void (* uartReceiveCallbackPtr)(uint16_t data);     // used by uart2 driver to return frames to app
+#define UART_FRAME_END      0x100                           // passed to uartReceiveCallbackPtr when the line went idle after a frame
 typedef uint16_t (* rcReadRawDataPtr)(uint8_t chan);        // used by receiver driver to return channel data
 
 typedef struct sensor_t
@@ -73,14 +80,14 @@ typedef struct sensor_t
 
 typedef struct baro_t
 {
-    uint16_t ut_delay;
-    uint16_t up_delay;
-    uint16_t repeat_delay;
+    uint16_t ut_delay;                                      // temperature conversion time, us
+    uint16_t up_delay;                                      // pressure conversion time, us
     sensorInitFuncPtr start_ut;
     sensorInitFuncPtr get_ut;
     sensorInitFuncPtr start_up;
     sensorInitFuncPtr get_up;
     baroCalculateFuncPtr calculate;
+    baroReadyFuncPtr ready;                                 // optional, NULL if the sensor has no end of conversion signal
 } baro_t;
 
 #define digitalHi(p, i)     { p->BSRR = i; }
@@ -99,6 +106,8 @@ typedef struct baro_t
 #define GYRO
 #define ACC
 
+#define RC_CHANS    8
+
 #else
  // Afroflight32
 #define LED0_GPIO   GPIOB
@@ -21,11 +21,10 @@ void buzzer(uint8_t warn_vbat)
     }
     //===================== Beeps for failsafe =====================
     if (feature(FEATURE_FAILSAFE)) {
-        if (failsafeCnt > (5 * cfg.failsafe_delay) && f.ARMED) {
-            warn_failsafe = 1;      //set failsafe warning level to 1 while landing
-            if (failsafeCnt > 5 * (cfg.failsafe_delay + cfg.failsafe_off_delay))
-                warn_failsafe = 2;  //start "find me" signal after landing   
-        }
+        if (failsafe.stage == FAILSAFE_RTH || failsafe.stage == FAILSAFE_LANDING)
+            warn_failsafe = 1;      //set failsafe warning level to 1 while returning home or landing
+        if (failsafe.stage == FAILSAFE_DISARMED)
+            warn_failsafe = 2;      //start "find me" signal after landing
         if (failsafeCnt > (5 * cfg.failsafe_delay) && !f.ARMED)
             warn_failsafe = 2;      // tx turned off while motors are off: start "find me" signal
         if (failsafeCnt == 0)
@@ -3,14 +3,18 @@
 
 // we unset this on 'exit'
 extern uint8_t cliMode;
+static void cliAutotune(char *cmdline);
 static void cliCMix(char *cmdline);
+static void cliCurve(char *cmdline);
 static void cliDefaults(char *cmdline);
 static void cliExit(char *cmdline);
 static void cliFeature(char *cmdline);
 static void cliHelp(char *cmdline);
+static void cliI2c(char *cmdline);
 static void cliMap(char *cmdline);
 static void cliMixer(char *cmdline);
 static void cliSave(char *cmdline);
+static void cliServo(char *cmdline);
 static void cliSet(char *cmdline);
 static void cliStatus(char *cmdline);
 static void cliVersion(char *cmdline);
@@ -18,6 +22,8 @@ static void cliVersion(char *cmdline);
 // from sensors.c
 extern uint8_t batteryCellCount;
 extern uint8_t accHardware;
+extern uint16_t baroConvOverrun;
+extern uint16_t sbusFramesLost;
 
 // from config.c RC Channel mapping
 extern const char rcChannelLetters[];
@@ -41,7 +47,8 @@ const char * const mixerNames[] = {
 const char * const featureNames[] = {
     "PPM", "VBAT", "INFLIGHT_ACC_CAL", "SPEKTRUM", "MOTOR_STOP",
     "SERVO_TILT", "GYRO_SMOOTHING", "LED_RING", "GPS",
-    "FAILSAFE", "SONAR", "TELEMETRY",
+    "FAILSAFE", "SONAR", "TELEMETRY", "POWERMETER",
+    "ONESHOT125", "DSHOT", "SBUS", "RX_MSP", "VBAT_COMP",
     NULL
 };
 
@@ -63,14 +70,18 @@ typedef struct {
 
 // should be sorted a..z for bsearch()
 const clicmd_t cmdTable[] = {
+    { "autotune", "show results or apply", cliAutotune },
     { "cmix", "design custom mixer", cliCMix },
+    { "curve", "name p0 p1 p2 p3 p4 or blank for list", cliCurve },
     { "defaults", "reset to defaults and reboot", cliDefaults },
     { "exit", "", cliExit },
     { "feature", "list or -val or val", cliFeature },
     { "help", "", cliHelp },
+    { "i2c", "show i2c bus statistics", cliI2c },
     { "map", "mapping of rc channel order", cliMap },
     { "mixer", "mixer name or list", cliMixer },
     { "save", "save and reboot", cliSave },
+    { "servo", "servo trim min max reverse rate", cliServo },
     { "set", "name=value or blank or * for list", cliSet },
     { "status", "show system status", cliStatus },
     { "version", "", cliVersion },
@@ -108,16 +119,31 @@ const clivalue_t valueTable[] = {
     { "failsafe_delay", VAR_UINT8, &cfg.failsafe_delay, 0, 200 },
     { "failsafe_off_delay", VAR_UINT8, &cfg.failsafe_off_delay, 0, 200 },
     { "failsafe_throttle", VAR_UINT16, &cfg.failsafe_throttle, 1000, 2000 },
+    { "rx_msp_timeout", VAR_UINT16, &cfg.rx_msp_timeout, 20, 2000 },
     { "motor_pwm_rate", VAR_UINT16, &cfg.motor_pwm_rate, 50, 498 },
     { "servo_pwm_rate", VAR_UINT16, &cfg.servo_pwm_rate, 50, 498 },
+    { "dshot_rate", VAR_UINT16, &cfg.dshot_rate, 150, 300 },
+    { "thrust_linear", VAR_UINT8, &cfg.thrust_linear, 0, 100 },
     { "serial_baudrate", VAR_UINT32, &cfg.serial_baudrate, 1200, 115200 },
     { "gps_baudrate", VAR_UINT32, &cfg.gps_baudrate, 1200, 115200 },
     { "spektrum_hires", VAR_UINT8, &cfg.spektrum_hires, 0, 1 },
     { "vbatscale", VAR_UINT8, &cfg.vbatscale, 10, 200 },
     { "vbatmaxcellvoltage", VAR_UINT8, &cfg.vbatmaxcellvoltage, 10, 50 },
     { "vbatmincellvoltage", VAR_UINT8, &cfg.vbatmincellvoltage, 10, 50 },
+    { "vbatcompcellvoltage", VAR_UINT8, &cfg.vbatcompcellvoltage, 30, 45 },
+    { "vbatcompmax", VAR_UINT8, &cfg.vbatcompmax, 100, 150 },
     { "power_adc_channel", VAR_UINT8, &cfg.power_adc_channel, 0, 9 },
+    { "currentscale", VAR_UINT16, &cfg.currentscale, 1, 10000 },
+    { "currentoffset", VAR_UINT16, &cfg.currentoffset, 0, 3300 },
+    { "batterycapacity", VAR_UINT16, &cfg.batterycapacity, 0, 20000 },
+    { "tpa_breakpoint", VAR_UINT16, &cfg.tpa_breakpoint, 1000, 2000 },
+    { "pid_controller", VAR_UINT8, &cfg.pid_controller, 0, 1 },
+    { "pid_max_rate", VAR_UINT16, &cfg.pid_max_rate, 50, 2000 },
+    { "pid_output_limit", VAR_UINT16, &cfg.pid_output_limit, 50, 1000 },
+    { "autotune_relay", VAR_UINT8, &cfg.autotune_relay, 20, 250 },
+    { "autotune_rule", VAR_UINT8, &cfg.autotune_rule, 0, 2 },
     { "yaw_direction", VAR_INT8, &cfg.yaw_direction, -1, 1 },
+    { "mixer_airmode", VAR_UINT8, &cfg.mixer_airmode, 0, 1 },
     { "tri_yaw_middle", VAR_UINT16, &cfg.tri_yaw_middle, 0, 2000 },
     { "tri_yaw_min", VAR_UINT16, &cfg.tri_yaw_min, 0, 2000 },
     { "tri_yaw_max", VAR_UINT16, &cfg.tri_yaw_max, 0, 2000 },
@@ -131,6 +157,12 @@ const clivalue_t valueTable[] = {
     { "pitch_direction_r", VAR_INT8, &cfg.pitch_direction_r, -1, 1 },
     { "roll_direction_l", VAR_INT8, &cfg.roll_direction_l, -1, 1 },
     { "roll_direction_r", VAR_INT8, &cfg.roll_direction_r, -1, 1 },
+    { "flaps", VAR_UINT8, &cfg.flaps, 0, AUX_CHANS },
+    { "flaperons", VAR_UINT8, &cfg.flaperons, 0, AUX_CHANS },
+    { "flapspeed", VAR_UINT8, &cfg.flapspeed, 0, 100 },
+    { "heli_swash_phase", VAR_INT16, &cfg.heli_swash_phase, -180, 180 },
+    { "heli_collective_throw", VAR_UINT16, &cfg.heli_collective_throw, 0, 500 },
+    { "heli_tail_revomix", VAR_INT8, &cfg.heli_tail_revomix, -100, 100 },
     { "gimbal_flags", VAR_UINT8, &cfg.gimbal_flags, 0, 255},
     { "gimbal_pitch_gain", VAR_INT8, &cfg.gimbal_pitch_gain, -100, 100 },
     { "gimbal_roll_gain", VAR_INT8, &cfg.gimbal_roll_gain, -100, 100 },
@@ -156,10 +188,13 @@ const clivalue_t valueTable[] = {
     { "acc_trim_roll", VAR_INT16, &cfg.angleTrim[ROLL], -300, 300 },
     { "gyro_lpf", VAR_UINT16, &cfg.gyro_lpf, 0, 256 },
     { "gyro_cmpf_factor", VAR_UINT16, &cfg.gyro_cmpf_factor, 100, 1000 },
+    { "i2c_speed", VAR_UINT16, &cfg.i2c_speed, 100, 1000 },
     { "mpu6050_scale", VAR_UINT8, &cfg.mpu6050_scale, 0, 1 },
     { "baro_tab_size", VAR_UINT8, &cfg.baro_tab_size, 0, BARO_TAB_SIZE_MAX },
     { "baro_noise_lpf", VAR_FLOAT, &cfg.baro_noise_lpf, 0, 1 },
     { "baro_cf", VAR_FLOAT, &cfg.baro_cf, 0, 1 },
+    { "baro_temp_interval", VAR_UINT8, &cfg.baro_temp_interval, 1, 50 },
+    { "ms5611_osr", VAR_UINT8, &cfg.ms5611_osr, 0, 4 },
     { "moron_threshold", VAR_UINT8, &cfg.moron_threshold, 0, 128 },
     { "mag_declination", VAR_INT16, &cfg.mag_declination, -18000, 18000 },
     { "gps_type", VAR_UINT8, &cfg.gps_type, 0, 3 },
@@ -388,6 +423,29 @@ static int cliCompare(const void *a, const void *b)
     return strncasecmp(ca->name, cb->name, strlen(cb->name));
 }
 
+static void cliAutotune(char *cmdline)
+{
+    uint8_t axis;
+    char buf[16];
+    const char * const states[] = { "idle", "running", "failed" };
+
+    if (strncasecmp(cmdline, "apply", 5) == 0) {
+        if (autotuneApply())
+            uartPrint("Gains applied, save to keep them\r\n");
+        else
+            uartPrint("No autotune results\r\n");
+        return;
+    }
+
+    printf("Autotune: %s\r\n", states[autotune.state]);
+    for (axis = ROLL; axis <= PITCH; axis++) {
+        if (!(autotune.done & (1 << axis)))
+            continue;
+        printf("%s: Ku %s ", axis == ROLL ? "ROLL" : "PITCH", ftoa(autotune.ku[axis], buf));
+        printf("Tu %s P %d I %d D %d (now %d %d %d)\r\n", ftoa(autotune.tu[axis], buf), autotune.P8[axis], autotune.I8[axis], autotune.D8[axis], cfg.P8[axis], cfg.I8[axis], cfg.D8[axis]);
+    }
+}
+
 static void cliCMix(char *cmdline)
 {
     int i, check = 0;
@@ -474,6 +532,74 @@ static void cliCMix(char *cmdline)
     }
 }
 
+typedef struct {
+    const char *name;
+    int8_t *points;
+    int8_t min;
+    int8_t max;
+} clicurve_t;
+
+// 5 point curves in percent, at 0/25/50/75/100% stick
+const clicurve_t curveTable[] = {
+    { "heli_pitch", cfg.heli_pitch_curve, -100, 100 },
+    { "heli_throttle", cfg.heli_throttle_curve, 0, 100 },
+    { "tpa_roll_p", cfg.tpa_p[ROLL], 0, 100 },
+    { "tpa_roll_i", cfg.tpa_i[ROLL], 0, 100 },
+    { "tpa_roll_d", cfg.tpa_d[ROLL], 0, 100 },
+    { "tpa_pitch_p", cfg.tpa_p[PITCH], 0, 100 },
+    { "tpa_pitch_i", cfg.tpa_i[PITCH], 0, 100 },
+    { "tpa_pitch_d", cfg.tpa_d[PITCH], 0, 100 },
+    { "tpa_yaw_p", cfg.tpa_p[YAW], 0, 100 },
+    { "tpa_yaw_i", cfg.tpa_i[YAW], 0, 100 },
+    { "tpa_yaw_d", cfg.tpa_d[YAW], 0, 100 },
+};
+
+#define CURVE_COUNT (sizeof(curveTable) / sizeof(curveTable[0]))
+
+static void cliCurve(char *cmdline)
+{
+    uint32_t i, j;
+    int val[5];
+    char *ptr;
+    const clicurve_t *curve = NULL;
+
+    if (strlen(cmdline) == 0) {
+        for (i = 0; i < CURVE_COUNT; i++) {
+            printf("%s:", curveTable[i].name);
+            for (j = 0; j < 5; j++)
+                printf(" %d", curveTable[i].points[j]);
+            uartPrint("\r\n");
+        }
+        return;
+    }
+
+    for (i = 0; i < CURVE_COUNT; i++) {
+        if (strncasecmp(cmdline, curveTable[i].name, strlen(curveTable[i].name)) == 0 && cmdline[strlen(curveTable[i].name)] == ' ')
+            curve = &curveTable[i];
+    }
+    if (!curve) {
+        uartPrint("Invalid curve name\r\n");
+        return;
+    }
+
+    ptr = cmdline;
+    for (i = 0; i < 5; i++) {
+        ptr = strchr(ptr, ' ');
+        if (!ptr)
+            break;
+        val[i] = atoi(++ptr);
+        if (val[i] < curve->min || val[i] > curve->max)
+            break;
+    }
+    if (i != 5) {
+        printf("Need 5 points in %d..%d\r\n", curve->min, curve->max);
+        return;
+    }
+    for (i = 0; i < 5; i++)
+        curve->points[i] = val[i];
+    cliCurve("");
+}
+
 static void cliDefaults(char *cmdline)
 {
     uartPrint("Resetting to defaults...\r\n");
@@ -558,6 +684,19 @@ static void cliHelp(char *cmdline)
         printf("%s\t%s\r\n", cmdTable[i].name, cmdTable[i].param);
 }
 
+static void cliI2c(char *cmdline)
+{
+    uint8_t i;
+    const i2cDeviceStats_t *dev;
+
+    printf("I2C bus: %dkHz, Errors: %d\r\n", i2cGetClockSpeed(), i2cGetErrorCounter());
+    uartPrint("Addr\tXfers\tErrors\tTmouts\tRetries\tLast\tMax\tAvg (us)\r\n");
+    for (i = 0; (dev = i2cGetDeviceStats(i)) != NULL; i++) {
+        printf("0x%x\t%d\t%d\t%d\t%d\t", dev->addr, dev->transfers, dev->errors, dev->timeouts, dev->retries);
+        printf("%d\t%d\t%d\r\n", dev->lastTime, dev->maxTime, dev->transfers ? dev->totalTime / dev->transfers : 0);
+    }
+}
+
 static void cliMap(char *cmdline)
 {
     uint32_t len;
@@ -628,6 +767,43 @@ static void cliSave(char *cmdline)
     systemReset(false);
 }
 
+static void cliServo(char *cmdline)
+{
+    int i, check = 0;
+    int16_t val[5];
+    char *ptr;
+
+    if (strlen(cmdline) == 0) {
+        uartPrint("Servo\tTrim\tMin\tMax\tReverse\tRate\r\n");
+        for (i = 0; i < 8; i++)
+            printf("#%d:\t%d\t%d\t%d\t%d\t%d\r\n", i, cfg.servotrim[i], cfg.servoendpoint_low[i], cfg.servoendpoint_high[i], cfg.servoreverse[i], cfg.servorate[i]);
+        return;
+    }
+
+    ptr = cmdline;
+    i = atoi(ptr); // get servo number
+    if (i < 0 || i >= 8) {
+        uartPrint("Invalid servo number\r\n");
+        return;
+    }
+    while (check < 5) {
+        ptr = strchr(ptr, ' ');
+        if (!ptr)
+            break;
+        val[check++] = atoi(++ptr);
+    }
+    if (check != 5 || val[0] < -500 || val[0] > 500 || val[1] < 500 || val[1] > val[2] || val[2] > 2500 || (val[3] != 1 && val[3] != -1) || val[4] < 0 || val[4] > 255) {
+        uartPrint("Usage: servo <0-7> <trim> <min> <max> <1/-1> <rate>\r\n");
+        return;
+    }
+    cfg.servotrim[i] = val[0];
+    cfg.servoendpoint_low[i] = val[1];
+    cfg.servoendpoint_high[i] = val[2];
+    cfg.servoreverse[i] = val[3];
+    cfg.servorate[i] = val[4];
+    cliServo("");
+}
+
 static void cliPrintVar(const clivalue_t *var, uint32_t full)
 {
     int32_t value = 0;
@@ -718,6 +894,11 @@ static void cliSet(char *cmdline)
         for (i = 0; i < VALUE_COUNT; i++) {
             val = &valueTable[i];
             if (strncasecmp(cmdline, valueTable[i].name, strlen(valueTable[i].name)) == 0) {
+                // DShot only comes as 150 and 300, nothing in between
+                if (val->ptr == &cfg.dshot_rate && value != 150 && value != 300) {
+                    uartPrint("ERR: Value assignment out of range\r\n");
+                    return;
+                }
                 if (valuef >= valueTable[i].min && valuef <= valueTable[i].max) { // here we compare the float value since... it should work, RIGHT?
                     cliSetVar(val, valueTable[i].type == VAR_FLOAT ? *(uint32_t *)&valuef : value); // this is a silly dirty hack. please fix me later.
                     printf("%s set to ", valueTable[i].name);
@@ -739,6 +920,8 @@ static void cliStatus(char *cmdline)
 
     printf("System Uptime: %d seconds, Voltage: %d * 0.1V (%dS battery)\r\n",
         millis() / 1000, vbat, batteryCellCount);
+    if (feature(FEATURE_POWERMETER) && cfg.power_adc_channel)
+        printf("Current: %d * 0.01A, Drawn: %d mAh\r\n", amperage, mAhDrawn);
     mask = sensorsMask();
 
     printf("CPU %dMHz, detected sensors: ", (SystemCoreClock / 1000000));
@@ -752,7 +935,16 @@ static void cliStatus(char *cmdline)
         printf("ACCHW: %s", accNames[accHardware]);
     uartPrint("\r\n");
 
-    printf("Cycle Time: %d, I2C Errors: %d\r\n", cycleTime, i2cGetErrorCounter());
+    printf("Cycle Time: %d, I2C Errors: %d, TX drops: %d", cycleTime, i2cGetErrorCounter(), uartGetTxDropped());
+    if (sensors(SENSOR_BARO))
+        printf(", Baro overruns: %d", baroConvOverrun);
+    if (feature(FEATURE_PPM))
+        printf(", PPM: %d ch, %d errors", pwmGetPPMChannels(), pwmGetPPMErrors());
+    if (feature(FEATURE_SPEKTRUM))
+        printf(", Spektrum frame: %d us", spektrumGetFrameInterval());
+    if (feature(FEATURE_SBUS))
+        printf(", SBUS lost frames: %d", sbusFramesLost);
+    uartPrint("\r\n");
 }
 
 static void cliVersion(char *cmdline)
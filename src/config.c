@@ -12,7 +12,7 @@
 config_t cfg;
 const char rcChannelLetters[] = "AERT1234";
 
-static uint8_t EEPROM_CONF_VERSION = 34;
+static uint8_t EEPROM_CONF_VERSION = 51;
 static uint32_t enabledSensors = 0;
 static void resetConf(void);
 
@@ -55,7 +55,7 @@ static uint8_t validEEPROM(void)
 
 void readEEPROM(void)
 {
-    uint8_t i;
+    uint8_t i, j;
 
     // Read flash
     memcpy(&cfg, (char *)FLASH_WRITE_ADDR, sizeof(config_t));
@@ -74,6 +74,22 @@ void readEEPROM(void)
         lookupThrottleRC[i] = cfg.minthrottle + (int32_t) (cfg.maxthrottle - cfg.minthrottle) * lookupThrottleRC[i] / 1000;     // [0;1000] -> [MINTHROTTLE;MAXTHROTTLE]
     }
 
+    // throttle PID attenuation at rcData[THROTTLE] 1000, 1100 .. 2000: the dynThrPID ramp and the 5 point tpa curves per axis
+    for (i = 0; i < 11; i++) {
+        int16_t throttle = 1000 + 100 * i;
+        int16_t pos = 0, seg, frac;
+        if (throttle > cfg.tpa_breakpoint && cfg.tpa_breakpoint < 2000)
+            pos = (int32_t)(throttle - cfg.tpa_breakpoint) * 1000 / (2000 - cfg.tpa_breakpoint);       // [BREAKPOINT;2000] -> [0;1000]
+        lookupThrottleDyn[i] = 100 - (uint16_t) cfg.dynThrPID * pos / 1000;
+        seg = min(pos / 250, 3);
+        frac = pos - seg * 250;
+        for (j = 0; j < 3; j++) {
+            lookupThrottlePID[j][0][i] = (cfg.tpa_p[j][seg] * (250 - frac) + cfg.tpa_p[j][seg + 1] * frac) / 250;
+            lookupThrottlePID[j][1][i] = (cfg.tpa_i[j][seg] * (250 - frac) + cfg.tpa_i[j][seg + 1] * frac) / 250;
+            lookupThrottlePID[j][2][i] = (cfg.tpa_d[j][seg] * (250 - frac) + cfg.tpa_d[j][seg + 1] * frac) / 250;
+        }
+    }
+
     cfg.tri_yaw_middle = constrain(cfg.tri_yaw_middle, cfg.tri_yaw_min, cfg.tri_yaw_max);       //REAR
 }
 
@@ -122,7 +138,7 @@ void checkFirstTime(bool reset)
 // Default settings
 static void resetConf(void)
 {
-    int i;
+    int i, j;
     const int8_t default_align[3][3] = { /* GYRO */ { 0, 0, 0 }, /* ACC */ { 0, 0, 0 }, /* MAG */ { -2, -3, 1 } };
 
     memset(&cfg, 0, sizeof(config_t));
@@ -166,6 +182,19 @@ static void resetConf(void)
     // cfg.rollPitchRate = 0;
     // cfg.yawRate = 0;
     // cfg.dynThrPID = 0;
+    cfg.tpa_breakpoint = 1500;
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 5; j++) {
+            cfg.tpa_p[i][j] = 100;
+            cfg.tpa_i[i][j] = 100;
+            cfg.tpa_d[i][j] = 100;
+        }
+    }
+    // cfg.pid_controller = 0;
+    cfg.pid_max_rate = 400;
+    cfg.pid_output_limit = 500;
+    cfg.autotune_relay = 80;
+    // cfg.autotune_rule = 0;
     cfg.thrMid8 = 50;
     // cfg.thrExpo8 = 0;
     // for (i = 0; i < CHECKBOXITEMS; i++)
@@ -183,19 +212,29 @@ static void resetConf(void)
     cfg.accz_deadband = 50;
     cfg.gyro_cmpf_factor = 400; // default MWC
     cfg.gyro_lpf = 42;
+    cfg.i2c_speed = 400;
     cfg.mpu6050_scale = 1; // fuck invensense
     cfg.baro_tab_size = 21;
     cfg.baro_noise_lpf = 0.6f;
     cfg.baro_cf = 0.985f;
+    cfg.baro_temp_interval = 4;
+    cfg.ms5611_osr = 4;
     cfg.moron_threshold = 32;
     cfg.gyro_smoothing_factor = 0x00141403;     // default factors of 20, 20, 3 for R/P/Y
     cfg.vbatscale = 110;
     cfg.vbatmaxcellvoltage = 43;
     cfg.vbatmincellvoltage = 33;
+    cfg.vbatcompcellvoltage = 40;
+    cfg.vbatcompmax = 130;
     // cfg.power_adc_channel = 0;
+    cfg.currentscale = 400;
+    // cfg.currentoffset = 0;
+    // cfg.batterycapacity = 0;
 
     // Radio
     parseRcChannels("AETR1234");
+    for (i = 8; i < RC_CHANS; i++)
+        cfg.rcmap[i] = i;
     // cfg.deadband = 0;
     // cfg.yawdeadband = 0;
     cfg.alt_hold_throttle_neutral = 20;
@@ -209,6 +248,7 @@ static void resetConf(void)
     cfg.failsafe_delay = 10;            // 1sec
     cfg.failsafe_off_delay = 200;       // 20sec
     cfg.failsafe_throttle = 1200;       // decent default which should always be below hover throttle for people.
+    cfg.rx_msp_timeout = 200;
 
     // Motor/ESC/Servo
     cfg.minthrottle = 1150;
@@ -216,9 +256,17 @@ static void resetConf(void)
     cfg.mincommand = 1000;
     cfg.motor_pwm_rate = 400;
     cfg.servo_pwm_rate = 50;
+    cfg.dshot_rate = 300;
+    // cfg.thrust_linear = 0;
+    for (i = 0; i < 8; i++) {
+        cfg.servoreverse[i] = 1;
+        cfg.servoendpoint_low[i] = 1020;
+        cfg.servoendpoint_high[i] = 2000;
+    }
 
     // servos
     cfg.yaw_direction = 1;
+    // cfg.mixer_airmode = 0;
     cfg.tri_yaw_middle = 1500;
     cfg.tri_yaw_min = 1020;
     cfg.tri_yaw_max = 2000;
@@ -235,6 +283,20 @@ static void resetConf(void)
     cfg.roll_direction_l = 1;
     cfg.roll_direction_r = 1;
 
+    // airplane
+    // cfg.flaps = 0;
+    // cfg.flaperons = 0;
+    // cfg.flapspeed = 0;
+
+    // helicopter, linear curves
+    // cfg.heli_swash_phase = 0;
+    cfg.heli_collective_throw = 200;
+    for (i = 0; i < 5; i++) {
+        cfg.heli_pitch_curve[i] = -100 + i * 50;
+        cfg.heli_throttle_curve[i] = i * 25;
+    }
+    // cfg.heli_tail_revomix = 0;
+
     // gimbal
     cfg.gimbal_pitch_gain = 10;
     cfg.gimbal_roll_gain = 10;
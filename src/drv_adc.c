@@ -3,8 +3,13 @@
 #define ADC_BATTERY     0
 #define ADC_CURRENT     1
 
-// static volatile uint16_t adc1Ch4Value = 0;
-static volatile uint16_t adcValues[2];
+// Conversions run back to back, DMA keeps the last ADC_OVERSAMPLE scans in adcSamples[] (interleaved when
+// there are two channels). With 239.5 cycle sampling at 12MHz a conversion takes 21us, so the average covers
+// ~0.7ms of battery ripple.
+#define ADC_OVERSAMPLE  16
+
+static volatile uint16_t adcSamples[ADC_OVERSAMPLE * 2];
+static uint8_t adcChannelCount = 1;
 
 void adcInit(drv_adc_config_t *init)
 {
@@ -12,14 +17,18 @@ void adcInit(drv_adc_config_t *init)
     DMA_InitTypeDef DMA_InitStructure;
     bool multiChannel = init->powerAdcChannel > 0;
 
+    adcChannelCount = multiChannel ? 2 : 1;
+    // 72MHz / 6 = 12MHz, ADC clock must stay below 14MHz
+    RCC_ADCCLKConfig(RCC_PCLK2_Div6);
+
     // ADC assumes all the GPIO was already placed in 'AIN' mode
     DMA_DeInit(DMA1_Channel1);
     DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR;
-    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)adcValues;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)adcSamples;
     DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
-    DMA_InitStructure.DMA_BufferSize = multiChannel ? 2 : 1;
+    DMA_InitStructure.DMA_BufferSize = ADC_OVERSAMPLE * adcChannelCount;
     DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
-    DMA_InitStructure.DMA_MemoryInc = multiChannel ? DMA_MemoryInc_Enable : DMA_MemoryInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
     DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
     DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
     DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
@@ -37,9 +46,9 @@ void adcInit(drv_adc_config_t *init)
     ADC_InitStructure.ADC_NbrOfChannel = multiChannel ? 2 : 1;
     ADC_Init(ADC1, &ADC_InitStructure);
 
-    ADC_RegularChannelConfig(ADC1, ADC_Channel_4, 1, ADC_SampleTime_28Cycles5);
+    ADC_RegularChannelConfig(ADC1, ADC_Channel_4, 1, ADC_SampleTime_239Cycles5);
     if (multiChannel)
-        ADC_RegularChannelConfig(ADC1, init->powerAdcChannel, 2, ADC_SampleTime_28Cycles5);
+        ADC_RegularChannelConfig(ADC1, init->powerAdcChannel, 2, ADC_SampleTime_239Cycles5);
     ADC_DMACmd(ADC1, ENABLE);
 
     ADC_Cmd(ADC1, ENABLE);
@@ -54,7 +63,13 @@ void adcInit(drv_adc_config_t *init)
     ADC_SoftwareStartConvCmd(ADC1, ENABLE);
 }
 
+// average of the last ADC_OVERSAMPLE conversions, still 0..4095
 uint16_t adcGetChannel(uint8_t channel)
 {
-    return adcValues[channel];
+    uint32_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < ADC_OVERSAMPLE; i++)
+        sum += adcSamples[i * adcChannelCount + channel];
+    return sum / ADC_OVERSAMPLE;
 }
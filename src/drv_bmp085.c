@@ -1,8 +1,7 @@
 #include "board.h"
 
 // BMP085, Standard address 0x77
-static bool convDone = false;
-static uint16_t convOverrun = 0;
+static volatile bool convDone = false;
 
 #define BARO_OFF                 digitalLo(BARO_GPIO, BARO_PIN);
 #define BARO_ON                  digitalHi(BARO_GPIO, BARO_PIN);
@@ -84,6 +83,7 @@ static void bmp085_start_ut(void);
 static void bmp085_get_ut(void);
 static void bmp085_start_up(void);
 static void bmp085_get_up(void);
+static bool bmp085_ready(void);
 static int16_t bmp085_get_temperature(uint32_t ut);
 static int32_t bmp085_get_pressure(uint32_t up);
 static int32_t bmp085_calculate(void);
@@ -137,11 +137,11 @@ bool bmp085Detect(baro_t *baro)
         bmp085InitDone = true;
         baro->ut_delay = 4600;
         baro->up_delay = 26000;
-        baro->repeat_delay = 5000;
         baro->start_ut = bmp085_start_ut;
         baro->get_ut = bmp085_get_ut;
         baro->start_up = bmp085_start_up;
         baro->get_up = bmp085_get_up;
+        baro->ready = bmp085_ready;
         baro->calculate = bmp085_calculate;
         return true;
     }
@@ -222,16 +222,7 @@ static void bmp085_start_ut(void)
 static void bmp085_get_ut(void)
 {
     uint8_t data[2];    
-    uint16_t timeout = 10000;
-
-    // wait in case of cockup
-    if (!convDone)
-        convOverrun++;
-#if 0
-    while (!convDone && timeout-- > 0) {
-        __NOP();
-    }
-#endif
+
     i2cRead(BMP085_I2C_ADDR, BMP085_ADC_OUT_MSB_REG, 2, data);
     bmp085_ut = (data[0] << 8) | data[1];
 }
@@ -252,20 +243,17 @@ static void bmp085_start_up(void)
 static void bmp085_get_up(void)
 {
     uint8_t data[3];
-    uint16_t timeout = 10000;
-    
-    // wait in case of cockup
-    if (!convDone)
-        convOverrun++;
-#if 0
-    while (!convDone && timeout-- > 0) {
-        __NOP();
-    }
-#endif
+
     i2cRead(BMP085_I2C_ADDR, BMP085_ADC_OUT_MSB_REG, 3, data);
     bmp085_up = (((uint32_t) data[0] << 16) | ((uint32_t) data[1] << 8) | (uint32_t) data[2]) >> (8 - bmp085.oversampling_setting);
 }
 
+// EOC went high, result of the last started conversion can be read
+static bool bmp085_ready(void)
+{
+    return convDone;
+}
+
 static int32_t bmp085_calculate(void)
 {
     bmp085_get_temperature(bmp085_ut);
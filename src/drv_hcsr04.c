@@ -10,80 +10,63 @@
  *
  * *** Warning: HC-SR04 operates at +5V ***
  *
+ * Trigger and echo are channel 3 and 4 of the same timer. The timer runs in one pulse mode, so each
+ * measurement is one counter run: the trigger output is forced high at start and dropped by the
+ * channel 3 compare, the echo edges are captured on channel 4, and the counter stops by itself at
+ * the end of the window. Nothing here waits on the CPU, and the ISR only stores capture values.
  */
 
-static uint16_t trigger_pin;
-static uint16_t echo_pin;
-static uint32_t exti_line;
-static uint8_t exti_pin_source;
-static IRQn_Type exti_irqn;
+#define HCSR04_TIMER_MHZ        2       // 0.5us resolution, 0xFFFF ticks = 32.7ms echo window (~5.5m)
+#define HCSR04_TRIGGER_TICKS    24      // 12us, the width of trig signal must be greater than 10us
+#define HCSR04_INTERVAL         60      // ms, to avoid interference between consecutive measurements
 
+static TIM_TypeDef *timer;
 static uint32_t last_measurement;
-static volatile int16_t* distance_ptr;
+static bool pending = false;
 
-void ECHO_EXTI_IRQHandler(void)
-{
-    static uint32_t timing_start;
-    uint32_t timing_stop;
-    if(GPIO_ReadInputDataBit(GPIOB, echo_pin) != 0)
-        timing_start = micros();
-    else 
-    {
-        timing_stop = micros();
-        if(timing_stop > timing_start) 
-        {
-            // The speed of sound is 340 m/s or approx. 29 microseconds per centimeter.
-            // The ping travels out and back, so to find the distance of the
-            // object we take half of the distance traveled.
-            //
-            // 340 m/s = 0.034 cm/microsecond = 29.41176471 *2 = 58.82352941 rounded to 59
-            int32_t pulse_duration = timing_stop - timing_start;          
-            *distance_ptr = pulse_duration / 59 ;
-        }
-    }
+static volatile uint16_t echo_rise;
+static volatile uint16_t echo_ticks;
+static volatile bool echo_done = false;
 
-    EXTI_ClearITPendingBit(exti_line);   
-}
-
-void EXTI1_IRQHandler(void)
+static void hcsr04_echo(uint8_t port, uint16_t capture)
 {
-    ECHO_EXTI_IRQHandler();
-}
-
-void EXTI9_5_IRQHandler(void)
-{
-    ECHO_EXTI_IRQHandler();
+    if (timer->CCER & TIM_CCER_CC4P) {
+        // falling edge, echo complete
+        echo_ticks = capture - echo_rise;
+        echo_done = true;
+        timer->CCER &= ~TIM_CCER_CC4P;  // next capture on the rising edge
+    } else {
+        echo_rise = capture;
+        timer->CCER |= TIM_CCER_CC4P;   // and on the falling edge
+    }
 }
 
 void hcsr04_init(sonar_config_t config)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
-    EXTI_InitTypeDef EXTIInit;
-
-    //enable AFIO for EXTI support - already done is drv_system.c
-    //RCC_APB2PeriphClockCmd(RCC_APB2Periph_AFIO | RCC_APB2Periph, ENABLE); 
-
+    TIM_TimeBaseInitTypeDef TIM_TimeBaseStructure;
+    TIM_OCInitTypeDef TIM_OCInitStructure;
+    TIM_ICInitTypeDef TIM_ICInitStructure;
+    uint16_t trigger_pin = 0;
+    uint16_t echo_pin = 0;
+    uint8_t echo_port = 0;
+    IRQn_Type irqn = TIM3_IRQn;
+
+    // No PB8/PB9 option: TIM4 also drives motor outputs PWM11..14 (PB6..PB9) and their DShot DMA
     switch(config)
     {
-    case sonar_pwm56:
-        trigger_pin = GPIO_Pin_8;   // PWM5 (PB8) - 5v tolerant
-        echo_pin = GPIO_Pin_9;      // PWM6 (PB9) - 5v tolerant
-        exti_line = EXTI_Line9;
-        exti_pin_source = GPIO_PinSource9;
-        exti_irqn = EXTI9_5_IRQn;
-        break;
     case sonar_rc78:    
-        trigger_pin = GPIO_Pin_0;   // RX7 (PB0) - only 3.3v ( add a 1K Ohms resistor )
-        echo_pin = GPIO_Pin_1;      // RX8 (PB1) - only 3.3v ( add a 1K Ohms resistor )
-        exti_line = EXTI_Line1;
-        exti_pin_source = GPIO_PinSource1;
-        exti_irqn = EXTI1_IRQn;
+        timer = TIM3;
+        trigger_pin = GPIO_Pin_0;   // RX7 (PB0, TIM3_CH3) - only 3.3v ( add a 1K Ohms resistor )
+        echo_pin = GPIO_Pin_1;      // RX8 (PB1, TIM3_CH4) - only 3.3v ( add a 1K Ohms resistor )
+        echo_port = PWM8;
+        irqn = TIM3_IRQn;
         break;
     }
     
-    // tp - trigger pin 
+    // tp - trigger pin, driven by the timer
     GPIO_InitStructure.GPIO_Pin = trigger_pin;
-    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
+    GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
     GPIO_InitStructure.GPIO_Speed = GPIO_Speed_2MHz;
     GPIO_Init(GPIOB, &GPIO_InitStructure);
 
@@ -92,41 +75,74 @@ void hcsr04_init(sonar_config_t config)
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IN_FLOATING;
     GPIO_Init(GPIOB, &GPIO_InitStructure);
 
-    // setup external interrupt on echo pin
-    GPIO_EXTILineConfig(GPIO_PortSourceGPIOB, exti_pin_source);
-
-    EXTI_ClearITPendingBit(exti_line);
-       
-    EXTIInit.EXTI_Line = exti_line;
-    EXTIInit.EXTI_Mode = EXTI_Mode_Interrupt;
-    EXTIInit.EXTI_Trigger = EXTI_Trigger_Rising_Falling;
-    EXTIInit.EXTI_LineCmd = ENABLE;    
-    EXTI_Init(&EXTIInit);    
-
-    NVIC_EnableIRQ(exti_irqn);
-
-    last_measurement = millis() - 60; // force 1st measurement in hcsr04_get_distance()
+    TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
+    TIM_TimeBaseStructure.TIM_Period = 0xFFFF;
+    TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / (HCSR04_TIMER_MHZ * 1000000)) - 1;
+    TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+    TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(timer, &TIM_TimeBaseStructure);
+    TIM_SelectOnePulseMode(timer, TIM_OPMode_Single);
+
+    // trigger: goes low on the compare match and stays there until the next hcsr04_start_reading()
+    TIM_OCStructInit(&TIM_OCInitStructure);
+    TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_Inactive;
+    TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+    TIM_OCInitStructure.TIM_Pulse = HCSR04_TRIGGER_TICKS;
+    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+    TIM_OC3Init(timer, &TIM_OCInitStructure);
+
+    TIM_ICInitStructure.TIM_Channel = TIM_Channel_4;
+    TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Rising;
+    TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_DirectTI;
+    TIM_ICInitStructure.TIM_ICPrescaler = TIM_ICPSC_DIV1;
+    TIM_ICInitStructure.TIM_ICFilter = 0x0;
+    TIM_ICInit(timer, &TIM_ICInitStructure);
+
+    // the timer ISR lives in drv_pwm.c. pwmInit() keeps off TIM3 when pwm_params.useSonar is set
+    pwmSetCaptureCallback(echo_port, hcsr04_echo);
+    TIM_ClearITPendingBit(timer, TIM_IT_CC4);
+    TIM_ITConfig(timer, TIM_IT_CC4, ENABLE);
+    NVIC_EnableIRQ(irqn);
+
+    last_measurement = millis() - HCSR04_INTERVAL; // force 1st measurement in hcsr04_start_reading()
 }
 
-// distance calculation is done asynchronously, using interrupt
-void hcsr04_get_distance(volatile int16_t* distance)
-{   
+// Starts a measurement if the previous one is finished and the repeat interval has passed.
+void hcsr04_start_reading(void)
+{
     uint32_t current_time = millis();
 
-    if( current_time < (last_measurement + 60) )
-    {
-        // the repeat interval of trig signal should be greater than 60ms
-        // to avoid interference between connective measurements.
+    if (current_time - last_measurement < HCSR04_INTERVAL || (timer->CR1 & TIM_CR1_CEN))
         return;
-    }
-        
+
     last_measurement = current_time;
-    distance_ptr = distance;
+    echo_done = false;
+    pending = true;
+    timer->CCER &= ~TIM_CCER_CC4P;
+    TIM_SetCounter(timer, 0);
+    // trigger high now, channel 3 compare drops it after HCSR04_TRIGGER_TICKS
+    TIM_ForcedOC3Config(timer, TIM_ForcedAction_Active);
+    timer->CCMR2 = (timer->CCMR2 & ~TIM_CCMR2_OC3M) | TIM_OCMode_Inactive;
+    TIM_Cmd(timer, ENABLE);
+}
 
-    GPIO_SetBits(GPIOB, trigger_pin);
-    //  The width of trig signal must be greater than 10us
-    delayMicroseconds(11);
-    GPIO_ResetBits(GPIOB, trigger_pin);
+// Returns true once per finished measurement. distance is in cm, or -1 if no echo came back within the window.
+bool hcsr04_get_distance(int32_t *distance)
+{
+    if (!pending)
+        return false;
+
+    if (echo_done) {
+        // 340 m/s = 0.034 cm/microsecond = 58.82 microseconds per centimeter there and back
+        *distance = (int32_t)echo_ticks * 100 / (HCSR04_TIMER_MHZ * 5882);
+    } else if (!(timer->CR1 & TIM_CR1_CEN)) {
+        // counter stopped at the end of the window without a falling edge
+        *distance = -1;
+    } else
+        return false;
+
+    pending = false;
+    return true;
 }
 
 #endif
@@ -33,7 +33,16 @@ void I2C2_EV_IRQHandler(void)
 
 
 #define I2C_DEFAULT_TIMEOUT 30000
+#define I2C_MAX_RETRIES     1
 static volatile uint16_t i2cErrorCount = 0;
+static uint32_t i2cClockSpeed = 400000;
+static i2cDeviceStats_t i2cStats[I2C_MAX_DEVICES];
+
+typedef enum {
+    I2C_RESULT_OK = 0,
+    I2C_RESULT_ERROR,
+    I2C_RESULT_TIMEOUT,
+} i2cResult_e;
 
 static volatile bool error = false;
 static volatile bool busy;
@@ -45,6 +54,7 @@ static volatile uint8_t writing;
 static volatile uint8_t reading;
 static volatile uint8_t* write_p;
 static volatile uint8_t* read_p;
+static volatile uint8_t subaddress_sent;    // register address went out, cleared for every new job and on errors
 
 static void i2c_er_handler(void)
 {
@@ -73,31 +83,34 @@ static void i2c_er_handler(void)
         }
     }
     I2Cx->SR1 &= ~0x0F00;       //reset all the error bits to clear the interrupt
+    subaddress_sent = 0;        //a retry has to send the register address again
     busy = 0;
 }
 
-bool i2cWriteBuffer(uint8_t addr_, uint8_t reg_, uint8_t len_, uint8_t *data)
+static i2cDeviceStats_t *i2cGetStatsSlot(uint8_t addr_)
 {
     uint8_t i;
-    uint8_t my_data[16];
+
+    for (i = 0; i < I2C_MAX_DEVICES; i++) {
+        if (i2cStats[i].addr == addr_)
+            return &i2cStats[i];
+        if (i2cStats[i].addr == 0) {
+            // first transaction with this device, claim the slot
+            i2cStats[i].addr = addr_;
+            return &i2cStats[i];
+        }
+    }
+    // table full, device goes untracked
+    return NULL;
+}
+
+static i2cResult_e i2cTransfer(void)
+{
     uint32_t timeout = I2C_DEFAULT_TIMEOUT;
 
-    addr = addr_ << 1;
-    reg = reg_;
-    writing = 1;
-    reading = 0;
-    write_p = my_data;
-    read_p = my_data;
-    bytes = len_;
     busy = 1;
     error = false;
-
-    // too long
-    if (len_ > 16)
-        return false;
-
-    for (i = 0; i < len_; i++)
-        my_data[i] = data[i];
+    subaddress_sent = 0;
 
     if (!(I2Cx->CR2 & I2C_IT_EVT)) {        //if we are restarting the driver
         if (!(I2Cx->CR1 & 0x0100)) {        // ensure sending a start
@@ -112,10 +125,66 @@ bool i2cWriteBuffer(uint8_t addr_, uint8_t reg_, uint8_t len_, uint8_t *data)
         i2cErrorCount++;
         // reinit peripheral + clock out garbage
         i2cInit(I2Cx);
-        return false;
+        return I2C_RESULT_TIMEOUT;
     }
 
-    return !error;
+    return error ? I2C_RESULT_ERROR : I2C_RESULT_OK;
+}
+
+// run the currently set up job, retrying on failure and recording per-device statistics
+static bool i2cJob(uint8_t addr_)
+{
+    i2cDeviceStats_t *stats = i2cGetStatsSlot(addr_);
+    i2cResult_e result;
+    uint32_t start = micros();
+    uint32_t elapsed;
+    uint8_t attempt = 0;
+
+    for (;;) {
+        result = i2cTransfer();
+        if (result == I2C_RESULT_OK || attempt++ >= I2C_MAX_RETRIES)
+            break;
+        if (stats)
+            stats->retries++;
+    }
+
+    if (stats) {
+        elapsed = micros() - start;
+        stats->transfers++;
+        if (result == I2C_RESULT_ERROR)
+            stats->errors++;
+        else if (result == I2C_RESULT_TIMEOUT)
+            stats->timeouts++;
+        stats->lastTime = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+        if (stats->lastTime > stats->maxTime)
+            stats->maxTime = stats->lastTime;
+        stats->totalTime += elapsed;
+    }
+
+    return result == I2C_RESULT_OK;
+}
+
+bool i2cWriteBuffer(uint8_t addr_, uint8_t reg_, uint8_t len_, uint8_t *data)
+{
+    uint8_t i;
+    uint8_t my_data[16];
+
+    // too long
+    if (len_ > 16)
+        return false;
+
+    addr = addr_ << 1;
+    reg = reg_;
+    writing = 1;
+    reading = 0;
+    write_p = my_data;
+    read_p = my_data;
+    bytes = len_;
+
+    for (i = 0; i < len_; i++)
+        my_data[i] = data[i];
+
+    return i2cJob(addr_);
 }
 
 bool i2cWrite(uint8_t addr_, uint8_t reg_, uint8_t data)
@@ -125,8 +194,6 @@ bool i2cWrite(uint8_t addr_, uint8_t reg_, uint8_t data)
 
 bool i2cRead(uint8_t addr_, uint8_t reg_, uint8_t len, uint8_t* buf)
 {
-    uint32_t timeout = I2C_DEFAULT_TIMEOUT;
-
     addr = addr_ << 1;
     reg = reg_;
     writing = 0;
@@ -134,31 +201,13 @@ bool i2cRead(uint8_t addr_, uint8_t reg_, uint8_t len, uint8_t* buf)
     read_p = buf;
     write_p = buf;
     bytes = len;
-    busy = 1;
-    error = false;
 
-    if (!(I2Cx->CR2 & I2C_IT_EVT)) {        //if we are restarting the driver
-        if (!(I2Cx->CR1 & 0x0100)) {        // ensure sending a start
-            while (I2Cx->CR1 & 0x0200) { ; }               //wait for any stop to finish sending
-            I2C_GenerateSTART(I2Cx, ENABLE);        //send the start for the new job
-        }
-        I2C_ITConfig(I2Cx, I2C_IT_EVT | I2C_IT_ERR, ENABLE);        //allow the interrupts to fire off again
-    }
-
-    while (busy && --timeout > 0);
-    if (timeout == 0) {
-        i2cErrorCount++;
-        // reinit peripheral + clock out garbage
-        i2cInit(I2Cx);
-        return false;
-    }
-
-    return !error;
+    return i2cJob(addr_);
 }
 
 void i2c_ev_handler(void)
 {
-    static uint8_t subaddress_sent, final_stop; //flag to indicate if subaddess sent, flag to indicate final bus condition
+    static uint8_t final_stop;  //flag to indicate final bus condition
     static int8_t index;        //index is signed -1==send the subaddress
     uint8_t SReg_1 = I2Cx->SR1; //read the status register here
 
@@ -285,7 +334,7 @@ void i2cInit(I2C_TypeDef *I2C)
     I2C_InitStructure.I2C_Mode = I2C_Mode_I2C;
     I2C_InitStructure.I2C_DutyCycle = I2C_DutyCycle_2;
     I2C_InitStructure.I2C_AcknowledgedAddress = I2C_AcknowledgedAddress_7bit;
-    I2C_InitStructure.I2C_ClockSpeed = 400000;
+    I2C_InitStructure.I2C_ClockSpeed = i2cClockSpeed;
     I2C_Cmd(I2Cx, ENABLE);
     I2C_Init(I2Cx, &I2C_InitStructure);
 
@@ -310,6 +359,31 @@ uint16_t i2cGetErrorCounter(void)
     return i2cErrorCount;
 }
 
+void i2cSetClockSpeed(uint16_t khz)
+{
+    // anything above 400kHz is out of spec for the STM32 and most sensors, but MPU/MS5611 generally cope with it
+    if (khz < 100)
+        khz = 100;
+    if (khz > 1000)
+        khz = 1000;
+    i2cClockSpeed = (uint32_t)khz * 1000;
+    // bus was already brought up by systemInit(), restart it at the new speed
+    if (I2Cx)
+        i2cInit(I2Cx);
+}
+
+uint16_t i2cGetClockSpeed(void)
+{
+    return i2cClockSpeed / 1000;
+}
+
+const i2cDeviceStats_t *i2cGetDeviceStats(uint8_t index)
+{
+    if (index >= I2C_MAX_DEVICES || i2cStats[index].addr == 0)
+        return NULL;
+    return &i2cStats[index];
+}
+
 static void i2cUnstick(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
@@ -1,7 +1,24 @@
 #pragma once
 
+#define I2C_MAX_DEVICES 8
+
+// per-address bus statistics, slots are claimed in order of first transaction
+typedef struct i2cDeviceStats_t {
+    uint8_t addr;               // 7-bit device address, 0 = unused slot
+    uint16_t transfers;         // completed transactions (after retries)
+    uint16_t errors;            // NACK / bus / arbitration errors reported by the ER interrupt
+    uint16_t timeouts;          // transactions which hung and forced a bus reinit
+    uint16_t retries;
+    uint16_t lastTime;          // duration of last transaction in us, including retries
+    uint16_t maxTime;           // worst case duration in us
+    uint32_t totalTime;         // sum of durations in us, average = totalTime / transfers
+} i2cDeviceStats_t;
+
 void i2cInit(I2C_TypeDef *I2Cx);
 bool i2cWriteBuffer(uint8_t addr_, uint8_t reg_, uint8_t len_, uint8_t *data);
 bool i2cWrite(uint8_t addr_, uint8_t reg, uint8_t data);
 bool i2cRead(uint8_t addr_, uint8_t reg, uint8_t len, uint8_t* buf);
 uint16_t i2cGetErrorCounter(void);
+void i2cSetClockSpeed(uint16_t khz);
+uint16_t i2cGetClockSpeed(void);
+const i2cDeviceStats_t *i2cGetDeviceStats(uint8_t index);
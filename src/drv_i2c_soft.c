@@ -212,4 +212,19 @@ uint16_t i2cGetErrorCounter(void)
     return 0;
 }
 
+void i2cSetClockSpeed(uint16_t khz)
+{
+    // bit-banged, speed is whatever I2C_delay() gives us
+}
+
+uint16_t i2cGetClockSpeed(void)
+{
+    return 0;
+}
+
+const i2cDeviceStats_t *i2cGetDeviceStats(uint8_t index)
+{
+    return NULL;
+}
+
 #endif
@@ -18,6 +18,7 @@
 #define CMD_ADC_4096            0x08 // ADC OSR=4096
 #define CMD_PROM_RD             0xA0 // Prom read command
 #define PROM_NB                 8
+#define OSR_NB                  5
 
 static void ms5611_reset(void);
 static uint16_t ms5611_prom(int8_t coef_num);
@@ -33,8 +34,11 @@ static uint32_t ms5611_ut;  // static result of temperature measurement
 static uint32_t ms5611_up;  // static result of pressure measurement
 static uint16_t ms5611_c[PROM_NB];  // on-chip ROM
 static uint8_t ms5611_osr = CMD_ADC_4096;
+// max conversion time in us for OSR 256..4096 (datasheet 0.60/1.17/2.28/4.54/9.04ms) plus a bit of margin
+static const uint16_t ms5611_conv_time[OSR_NB] = { 650, 1250, 2400, 4700, 9200 };
 
-bool ms5611Detect(baro_t *baro)
+// osr: 0..4 for OSR 256, 512, 1024, 2048, 4096
+bool ms5611Detect(baro_t *baro, uint8_t osr)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
     bool ack = false;
@@ -64,14 +68,17 @@ bool ms5611Detect(baro_t *baro)
     if (ms5611_crc(ms5611_c) != 0)
         return false;
 
-    // TODO prom + CRC
-    baro->ut_delay = 10000;
-    baro->up_delay = 10000;
-    baro->repeat_delay = 4000;
+    if (osr >= OSR_NB)
+        osr = OSR_NB - 1;
+    ms5611_osr = CMD_ADC_256 + osr * 2;
+
+    baro->ut_delay = ms5611_conv_time[osr];
+    baro->up_delay = ms5611_conv_time[osr];
     baro->start_ut = ms5611_start_ut;
     baro->get_ut = ms5611_get_ut;
     baro->start_up = ms5611_start_up;
     baro->get_up = ms5611_get_up;
+    baro->ready = NULL; // no EOC pin, conversions are timed
     baro->calculate = ms5611_calculate;
 
     return true;
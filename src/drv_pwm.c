@@ -1,6 +1,11 @@
 #include "board.h"
+#include "dshot.h"
 
 #define PULSE_1MS       (1000) // 1ms pulse width
+#define ONESHOT_MHZ     (8)    // 1000..2000 ticks are the 125..250us OneShot125 range
+#define ONESHOT_PERIOD  (2100) // one pulse per trigger, ends at the update event
+#define PPM_BUFFER_SIZE     64  // edge timestamps, a few frames worth
+#define PPM_MIN_CHANNELS    4
 
 /* FreeFlight/Naze32 timer layout
     TIM2_CH1    RC1             PWM1
@@ -72,8 +77,6 @@
     PWM11.14 used for servos
 */
 
-typedef void pwmCallbackPtr(uint8_t port, uint16_t capture);
-
 static pwmHardware_t timerHardware[] = {
     { TIM2, GPIOA, GPIO_Pin_0, TIM_Channel_1, TIM2_IRQn, 0, },          // PWM1
     { TIM2, GPIOA, GPIO_Pin_1, TIM_Channel_2, TIM2_IRQn, 0, },          // PWM2
@@ -94,6 +97,7 @@ static pwmHardware_t timerHardware[] = {
 typedef struct {
     pwmCallbackPtr *callback;
     volatile uint16_t *ccr;
+    uint16_t *dshot;    // first bit of this output in its timer's DShot buffer
     uint16_t period;
 
     // for input only
@@ -113,13 +117,43 @@ enum {
 
 static pwmPortData_t pwmPorts[MAX_PORTS];
 static uint16_t captures[MAX_INPUTS];
+// PPM rising edge timestamps. Written by DMA from TIM2_CCR2, or by ppmCallback() if the DMA channel is taken
+static volatile uint16_t ppmBuffer[PPM_BUFFER_SIZE];
+static volatile uint8_t ppmHead = 0;
+static uint8_t ppmTail = 0;
+static bool ppmUseDMA = false;
+static uint8_t ppmChannels = 0;         // channels per frame, learned from the stream
+static uint16_t ppmErrors = 0;          // frames dropped for bad pulse width or channel count
+static uint32_t ppmFrameTime = 0;       // micros() at the last edge of the last good frame
 static pwmPortData_t *motors[MAX_MOTORS];
 static pwmPortData_t *servos[MAX_SERVOS];
 static uint8_t numMotors = 0;
 static uint8_t numServos = 0;
+static TIM_TypeDef *servoTimer = NULL;  // frame reference for pwmServoFrameStart()
 static uint8_t  numInputs = 0;
-// external vars (ugh)
-extern int16_t failsafeCnt;
+static bool useOneshot = false;
+// timers driving OneShot motors, restarted once per loop
+static TIM_TypeDef *oneshotTimers[3];
+static uint8_t numOneshotTimers = 0;
+static bool useDshot = false;
+
+typedef struct {
+    TIM_TypeDef *tim;
+    DMA_Channel_TypeDef *dma;
+    uint16_t dmaSource;
+    bool used;
+    uint16_t buffer[DSHOT_BUFFER_LENGTH * 4];   // CCR1..4 for each bit, one DMA burst per timer update
+} dshotTimer_t;
+
+// TIM1_UP would be DMA1 channel 5 which is USART1 RX, so TIM1 uses its CC1 request instead, moved to the update event
+static dshotTimer_t dshotTimers[] = {
+    { TIM1, DMA1_Channel2, TIM_DMA_CC1, },
+    { TIM3, DMA1_Channel3, TIM_DMA_Update, },
+    { TIM4, DMA1_Channel7, TIM_DMA_Update, },
+};
+// external functions (ugh)
+void failsafeOnValidFrame(void);
+void failsafeOnGlitch(void);
 
 static const uint8_t multiPPM[] = {
     PWM1 | TYPE_IP,     // PPM input
@@ -194,13 +228,13 @@ static const uint8_t *hardwareMaps[] = {
     airPPM,
 };
 
-static void pwmTimeBase(TIM_TypeDef *tim, uint32_t period)
+static void pwmTimeBase(TIM_TypeDef *tim, uint32_t period, uint8_t mhz)
 {
     TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
 
     TIM_TimeBaseStructInit(&TIM_TimeBaseStructure);
     TIM_TimeBaseStructure.TIM_Period = period - 1;
-    TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / 1000000) - 1; // all timers run at 1MHz
+    TIM_TimeBaseStructure.TIM_Prescaler = (SystemCoreClock / (mhz * 1000000)) - 1; // all timers run at 1MHz, except OneShot
     TIM_TimeBaseStructure.TIM_ClockDivision = 0;
     TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
     TIM_TimeBaseInit(tim, &TIM_TimeBaseStructure);
@@ -217,7 +251,7 @@ static void pwmNVICConfig(uint8_t irq)
     NVIC_Init(&NVIC_InitStructure);
 }
 
-static void pwmOCConfig(TIM_TypeDef *tim, uint8_t channel, uint16_t value)
+static void pwmOCConfig(TIM_TypeDef *tim, uint8_t channel, uint16_t value, uint16_t polarity)
 {
     TIM_OCInitTypeDef  TIM_OCInitStructure;
 
@@ -226,7 +260,7 @@ static void pwmOCConfig(TIM_TypeDef *tim, uint8_t channel, uint16_t value)
     TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
     TIM_OCInitStructure.TIM_OutputNState = TIM_OutputNState_Disable;
     TIM_OCInitStructure.TIM_Pulse = value;
-    TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_Low;
+    TIM_OCInitStructure.TIM_OCPolarity = polarity;
     TIM_OCInitStructure.TIM_OCIdleState = TIM_OCIdleState_Set;
 
     switch (channel) {
@@ -277,16 +311,21 @@ static void pwmGPIOConfig(GPIO_TypeDef *gpio, uint32_t pin, uint8_t input)
     GPIO_Init(gpio, &GPIO_InitStructure);
 }
 
-static pwmPortData_t *pwmOutConfig(uint8_t port, uint16_t period, uint16_t value)
+static pwmPortData_t *pwmOutConfig(uint8_t port, uint8_t mhz, uint16_t period, uint16_t value, bool oneshot)
 {
     pwmPortData_t *p = &pwmPorts[port];
-    pwmTimeBase(timerHardware[port].tim, period);
+    pwmTimeBase(timerHardware[port].tim, period, mhz);
     pwmGPIOConfig(timerHardware[port].gpio, timerHardware[port].pin, 0);
-    pwmOCConfig(timerHardware[port].tim, timerHardware[port].channel, value);
+    // OneShot output stays low until the counter passes CCR, then high until the update event where one pulse
+    // mode stops the counter. So the pulse is ONESHOT_PERIOD - CCR wide and all pulses on a timer end together.
+    pwmOCConfig(timerHardware[port].tim, timerHardware[port].channel, value, oneshot ? TIM_OCPolarity_High : TIM_OCPolarity_Low);
     // Needed only on TIM1
     if (timerHardware[port].outputEnable)
         TIM_CtrlPWMOutputs(timerHardware[port].tim, ENABLE);
-    TIM_Cmd(timerHardware[port].tim, ENABLE);
+    if (oneshot)
+        TIM_SelectOnePulseMode(timerHardware[port].tim, TIM_OPMode_Single); // started by pwmCompleteMotorUpdate()
+    else
+        TIM_Cmd(timerHardware[port].tim, ENABLE);
 
     switch (timerHardware[port].channel) {
         case TIM_Channel_1:
@@ -305,10 +344,98 @@ static pwmPortData_t *pwmOutConfig(uint8_t port, uint16_t period, uint16_t value
     return p;
 }
 
+// Timer runs at the DShot bit rate and a DMA burst reloads all four CCRs on every update. The buffer is only
+// streamed once per pwmCompleteMotorUpdate(), in between CCRs stay at 0 and the outputs low.
+static pwmPortData_t *pwmDshotConfig(uint8_t port, uint16_t rate)
+{
+    DMA_InitTypeDef DMA_InitStructure;
+    TIM_TypeDef *tim = timerHardware[port].tim;
+    dshotTimer_t *d = NULL;
+    pwmPortData_t *p;
+    uint8_t i;
+
+    for (i = 0; i < sizeof(dshotTimers) / sizeof(dshotTimers[0]); i++) {
+        if (dshotTimers[i].tim == tim)
+            d = &dshotTimers[i];
+    }
+
+    // 24MHz for DShot300, 12MHz for DShot150
+    p = pwmOutConfig(port, rate * DSHOT_BIT_TICKS / 1000, DSHOT_BIT_TICKS, 0, false);
+    // TIM_Channel_x is 0, 4, 8, 12
+    p->dshot = &d->buffer[timerHardware[port].channel >> 2];
+    dshotEncode(dshotPacket(0, false), p->dshot, 4);
+
+    if (d->used)
+        return p;
+
+    DMA_DeInit(d->dma);
+    DMA_StructInit(&DMA_InitStructure);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&tim->DMAR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)d->buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+    DMA_InitStructure.DMA_BufferSize = DSHOT_BUFFER_LENGTH * 4;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_High;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(d->dma, &DMA_InitStructure);
+
+    TIM_DMAConfig(tim, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+    if (d->dmaSource == TIM_DMA_CC1)
+        TIM_SelectCCDMA(tim, ENABLE);
+    TIM_DMACmd(tim, d->dmaSource, ENABLE);
+    d->used = true;
+
+    return p;
+}
+
+// TIM2_CH1 DMA request is on DMA1 channel 5 which USART1 RX uses, so the PPM pin is captured through CH2
+// (TI1 indirect) whose request is on channel 7. One DMA transfer per edge into ppmBuffer, no interrupts.
+static void pwmPPMDMAConfig(uint8_t port)
+{
+    TIM_ICInitTypeDef TIM_ICInitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
+    TIM_TypeDef *tim = timerHardware[port].tim;
+
+    pwmTimeBase(tim, 0xFFFF, 1);
+    pwmGPIOConfig(timerHardware[port].gpio, timerHardware[port].pin, 1);
+
+    TIM_ICStructInit(&TIM_ICInitStructure);
+    TIM_ICInitStructure.TIM_Channel = TIM_Channel_2;
+    TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Rising;
+    TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_IndirectTI;
+    TIM_ICInitStructure.TIM_ICPrescaler = TIM_ICPSC_DIV1;
+    TIM_ICInitStructure.TIM_ICFilter = 0x0;
+    TIM_ICInit(tim, &TIM_ICInitStructure);
+
+    DMA_DeInit(DMA1_Channel7);
+    DMA_StructInit(&DMA_InitStructure);
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&tim->CCR2;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)ppmBuffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_BufferSize = PPM_BUFFER_SIZE;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_Init(DMA1_Channel7, &DMA_InitStructure);
+    DMA_Cmd(DMA1_Channel7, ENABLE);
+
+    TIM_DMACmd(tim, TIM_DMA_CC2, ENABLE);
+    TIM_Cmd(tim, ENABLE);
+    ppmUseDMA = true;
+}
+
 static pwmPortData_t *pwmInConfig(uint8_t port, pwmCallbackPtr callback, uint8_t channel)
 {
     pwmPortData_t *p = &pwmPorts[port];
-    pwmTimeBase(timerHardware[port].tim, 0xFFFF);
+    pwmTimeBase(timerHardware[port].tim, 0xFFFF, 1);
     pwmGPIOConfig(timerHardware[port].gpio, timerHardware[port].pin, 1);
     pwmICConfig(timerHardware[port].tim, timerHardware[port].channel, TIM_ICPolarity_Rising);
     TIM_Cmd(timerHardware[port].tim, ENABLE);
@@ -388,28 +515,89 @@ void TIM4_IRQHandler(void)
     pwmTIMxHandler(TIM4, PWM11); // PWM11..14
 }
 
+// only used when the PPM DMA channel is taken, queues the edge for pwmDecodePPM()
 static void ppmCallback(uint8_t port, uint16_t capture)
 {
-    uint16_t diff;
-    static uint16_t now;
+    ppmBuffer[ppmHead] = capture;
+    ppmHead = (ppmHead + 1) % PPM_BUFFER_SIZE;
+}
+
+// Decode the PPM edges captured since the last call, called from main loop. A frame is only used if every pulse
+// is in range and the channel count matches the previous frames. It is taken as soon as the last expected
+// channel arrives instead of waiting for the sync gap.
+void pwmDecodePPM(void)
+{
     static uint16_t last = 0;
     static uint8_t chan = 0;
+    static bool frameValid = false;
+    static uint16_t pulses[MAX_INPUTS];
+    uint16_t now, diff;
+    uint8_t head, i;
 
-    last = now;
-    now = capture;
-    diff = now - last;
-
-    if (diff > 2700) { // Per http://www.rcgroups.com/forums/showpost.php?p=21996147&postcount=3960 "So, if you use 2.5ms or higher as being the reset for the PPM stream start, you will be fine. I use 2.7ms just to be safe."
-        chan = 0;
-    } else {
-        if (diff > 750 && diff < 2250 && chan < 8) {   // 750 to 2250 ms is our 'valid' channel range
-            captures[chan] = diff;
+    if (ppmUseDMA)
+        head = (PPM_BUFFER_SIZE - DMA1_Channel7->CNDTR) % PPM_BUFFER_SIZE;
+    else
+        head = ppmHead;
+
+    while (ppmTail != head) {
+        now = ppmBuffer[ppmTail];
+        ppmTail = (ppmTail + 1) % PPM_BUFFER_SIZE;
+        diff = now - last;
+        last = now;
+
+        if (diff > 2700) { // Per http://www.rcgroups.com/forums/showpost.php?p=21996147&postcount=3960 "So, if you use 2.5ms or higher as being the reset for the PPM stream start, you will be fine. I use 2.7ms just to be safe."
+            // frame ended without matching the expected count, relearn it from this one
+            if (chan != ppmChannels) {
+                if (ppmChannels) {
+                    ppmErrors++;
+                    failsafeOnGlitch();
+                }
+                if (frameValid && chan >= PPM_MIN_CHANNELS && chan <= MAX_INPUTS)
+                    ppmChannels = chan;
+            }
+            chan = 0;
+            frameValid = true;
+        } else {
+            if (diff > 750 && diff < 2250 && chan < MAX_INPUTS) {   // 750 to 2250 ms is our 'valid' channel range
+                pulses[chan] = diff;
+            } else if (frameValid) {
+                frameValid = false;
+                ppmErrors++;
+                failsafeOnGlitch();
+            }
+            chan++;
+            if (chan == ppmChannels && frameValid) {
+                for (i = 0; i < chan; i++)
+                    captures[i] = pulses[i];
+                // edge timestamp is TIM2 time, convert to micros() by its age
+                ppmFrameTime = micros() - (uint16_t)(TIM2->CNT - now);
+                failsafeOnValidFrame();
+            }
         }
-        chan++;
-        failsafeCnt = 0;
     }
 }
 
+uint32_t pwmGetPPMFrameTime(void)
+{
+    return ppmFrameTime;
+}
+
+uint8_t pwmGetPPMChannels(void)
+{
+    return ppmChannels;
+}
+
+uint16_t pwmGetPPMErrors(void)
+{
+    return ppmErrors;
+}
+
+// capture interrupts of a channel configured outside this driver (sonar echo) are routed here
+void pwmSetCaptureCallback(uint8_t port, pwmCallbackPtr *callback)
+{
+    pwmPorts[port].callback = callback;
+}
+
 static void pwmCallback(uint8_t port, uint16_t capture)
 {
     if (pwmPorts[port].state == 0) {
@@ -424,14 +612,15 @@ static void pwmCallback(uint8_t port, uint16_t capture)
         // switch state
         pwmPorts[port].state = 0;
         pwmICConfig(timerHardware[port].tim, timerHardware[port].channel, TIM_ICPolarity_Rising);
-        // reset failsafe
-        failsafeCnt = 0;
+        // one frame per period of the first input
+        if (pwmPorts[port].channel == 0)
+            failsafeOnValidFrame();
     }
 }
 
 bool pwmInit(drv_pwm_config_t *init)
 {
-    int i = 0;
+    int i = 0, j;
     const uint8_t *setup;
 
     // this is pretty hacky shit, but it will do for now. array of 4 config maps, [ multiPWM multiPPM airPWM airPPM ]
@@ -441,6 +630,11 @@ bool pwmInit(drv_pwm_config_t *init)
         i++; // next index is for PPM
 
     setup = hardwareMaps[i];
+    useOneshot = init->oneshot;
+    if (init->dshotRate) {
+        useDshot = true;
+        useOneshot = false;
+    }
 
     for (i = 0; i < MAX_PORTS; i++) {
         uint8_t port = setup[i] & 0x0F;
@@ -453,6 +647,10 @@ bool pwmInit(drv_pwm_config_t *init)
         if (init->useUART && (port == PWM3 || port == PWM4))
             continue;
 
+        // sonar runs its own time base on TIM3
+        if (init->useSonar && port >= PWM5 && port <= PWM8)
+            continue;
+
         // skip ADC for powerMeter if configured
         if (init->adcChannel && (init->adcChannel == PWM2 || init->adcChannel == PWM8))
             continue;
@@ -474,15 +672,29 @@ bool pwmInit(drv_pwm_config_t *init)
         }
 
         if (mask & TYPE_IP) {
-            pwmInConfig(port, ppmCallback, 0);
-            numInputs = 8;
+            // DShot on TIM4 has DMA1 channel 7
+            if (init->dshotRate)
+                pwmInConfig(port, ppmCallback, 0);
+            else
+                pwmPPMDMAConfig(port);
+            numInputs = MAX_INPUTS;
         } else if (mask & TYPE_IW) {
             pwmInConfig(port, pwmCallback, numInputs);
             numInputs++;
         } else if (mask & TYPE_M) {
-            motors[numMotors++] = pwmOutConfig(port, 1000000 / init->motorPwmRate, PULSE_1MS);
+            if (useDshot) {
+                motors[numMotors++] = pwmDshotConfig(port, init->dshotRate);
+            } else if (useOneshot) {
+                motors[numMotors++] = pwmOutConfig(port, ONESHOT_MHZ, ONESHOT_PERIOD, ONESHOT_PERIOD - PULSE_1MS, true);
+                for (j = 0; j < numOneshotTimers && oneshotTimers[j] != timerHardware[port].tim; j++);
+                if (j == numOneshotTimers)
+                    oneshotTimers[numOneshotTimers++] = timerHardware[port].tim;
+            } else
+                motors[numMotors++] = pwmOutConfig(port, 1, 1000000 / init->motorPwmRate, PULSE_1MS, false);
         } else if (mask & TYPE_S) {
-            servos[numServos++] = pwmOutConfig(port, 1000000 / init->servoPwmRate, PULSE_1MS);
+            servos[numServos++] = pwmOutConfig(port, 1, 1000000 / init->servoPwmRate, PULSE_1MS, false);
+            if (!servoTimer)
+                servoTimer = timerHardware[port].tim;
         }
     }
 
@@ -491,8 +703,45 @@ bool pwmInit(drv_pwm_config_t *init)
 
 void pwmWriteMotor(uint8_t index, uint16_t value)
 {
-    if (index < numMotors)
-        *motors[index]->ccr = value;
+    if (index < numMotors) {
+        if (useDshot) {
+            dshotEncode(dshotPacket(dshotThrottle(value), false), motors[index]->dshot, 4);
+        } else if (useOneshot) {
+            // 1000..2000 -> 125..250us at 8MHz
+            if (value > ONESHOT_PERIOD)
+                value = ONESHOT_PERIOD;
+            *motors[index]->ccr = ONESHOT_PERIOD - value;
+        } else
+            *motors[index]->ccr = value;
+    }
+}
+
+// Fire one pulse with the values from pwmWriteMotor() on each OneShot timer, or send one DShot frame.
+// Nothing to do for normal PWM.
+void pwmCompleteMotorUpdate(void)
+{
+    uint8_t i;
+
+    if (useDshot) {
+        for (i = 0; i < sizeof(dshotTimers) / sizeof(dshotTimers[0]); i++) {
+            if (!dshotTimers[i].used)
+                continue;
+            DMA_Cmd(dshotTimers[i].dma, DISABLE);
+            dshotTimers[i].dma->CNDTR = DSHOT_BUFFER_LENGTH * 4;
+            DMA_Cmd(dshotTimers[i].dma, ENABLE);
+        }
+        return;
+    }
+
+    for (i = 0; i < numOneshotTimers; i++) {
+        TIM_TypeDef *tim = oneshotTimers[i];
+        // previous pulse still running, it'll pick up the new values next time
+        if (tim->CR1 & TIM_CR1_CEN)
+            continue;
+        // load preloaded compare values and reset counter, then run until the update event
+        tim->EGR = TIM_EGR_UG;
+        tim->CR1 |= TIM_CR1_CEN;
+    }
 }
 
 void pwmWriteServo(uint8_t index, uint16_t value)
@@ -501,6 +750,15 @@ void pwmWriteServo(uint8_t index, uint16_t value)
         *servos[index]->ccr = value;
 }
 
+// True once per period of the first servo timer, used to step per-frame servo limits.
+bool pwmServoFrameStart(void)
+{
+    if (!servoTimer || TIM_GetFlagStatus(servoTimer, TIM_FLAG_Update) == RESET)
+        return false;
+    TIM_ClearFlag(servoTimer, TIM_FLAG_Update);
+    return true;
+}
+
 uint16_t pwmRead(uint8_t channel)
 {
     return captures[channel];
@@ -2,7 +2,7 @@
 
 #define MAX_MOTORS  12
 #define MAX_SERVOS  8
-#define MAX_INPUTS  8
+#define MAX_INPUTS  16  // PPM, PWM input is limited to the 8 physical pins
 
 typedef struct drv_pwm_config_t {
     bool enableInput;
@@ -12,6 +12,9 @@ typedef struct drv_pwm_config_t {
     bool extraServos;    // configure additional 4 channels in PPM mode as servos, not motors
     bool airplane;       // fixed wing hardware config, lots of servos etc
     uint8_t adcChannel;  // steal one RC input for current sensor
+    bool oneshot;        // motors get a single OneShot125 pulse per pwmCompleteMotorUpdate() instead of free running PWM
+    uint16_t dshotRate;  // DShot150/300 motor output (kbit/s, 150 or 300) instead of PWM, 0 = off
+    bool useSonar;       // TIM3 belongs to the sonar on RC7/RC8, PWM5..8 are left alone
     uint16_t motorPwmRate;
     uint16_t servoPwmRate;
 } drv_pwm_config_t;
@@ -44,9 +47,18 @@ typedef struct {
     uint8_t outputEnable;
 } pwmHardware_t;
 
+typedef void pwmCallbackPtr(uint8_t port, uint16_t capture);
+
 bool pwmInit(drv_pwm_config_t *init); // returns whether driver is asking to calibrate throttle or not
 void pwmWriteMotor(uint8_t index, uint16_t value);
+void pwmCompleteMotorUpdate(void);
 void pwmWriteServo(uint8_t index, uint16_t value);
+bool pwmServoFrameStart(void);
 uint16_t pwmRead(uint8_t channel);
+void pwmDecodePPM(void);
+uint32_t pwmGetPPMFrameTime(void);
+uint8_t pwmGetPPMChannels(void);
+uint16_t pwmGetPPMErrors(void);
+void pwmSetCaptureCallback(uint8_t port, pwmCallbackPtr *callback);
 
 // void pwmWrite(uint8_t channel, uint16_t value);
@@ -10,8 +10,8 @@
 static void pwmIRQHandler(TIM_TypeDef *tim);
 static void ppmIRQHandler(TIM_TypeDef *tim);
 
-// external vars (ugh)
-extern int16_t failsafeCnt;
+// external functions (ugh)
+void failsafeOnValidFrame(void);
 
 // local vars
 static struct TIM_Channel {
@@ -88,7 +88,7 @@ static void ppmIRQHandler(TIM_TypeDef *tim)
             Inputs[chan].capture = diff;
         }
         chan++;
-        failsafeCnt = 0;
+        failsafeOnValidFrame();
     }
 }
 
@@ -142,7 +142,7 @@ static void pwmIRQHandler(TIM_TypeDef *tim)
                 state->state = 0;
 
                 // ping failsafe
-                failsafeCnt = 0;
+                failsafeOnValidFrame();
 
                 TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Rising;
                 TIM_ICInitStructure.TIM_Channel = channel.channel;
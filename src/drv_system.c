@@ -8,40 +8,35 @@ typedef struct gpio_config_t
 } gpio_config_t;
 
 // cycles per microsecond
-static volatile uint32_t usTicks = 0;
+uint32_t usTicks = 0;
+// 2^32 / usTicks rounded up, turns the divide in micros() into a multiply
+uint32_t usTicksInv = 0;
 // current uptime for 1kHz systick timer. will rollover after 49 days. hopefully we won't care.
-static volatile uint32_t sysTickUptime = 0;
+volatile uint32_t sysTickUptime = 0;
+// DWT_CYCCNT at the nominal time of the last systick. Advanced by exactly one ms worth of cycles per tick,
+// so interrupt latency doesn't leak into micros()
+volatile uint32_t sysTickCycles = 0;
 
 static void cycleCounterInit(void)
 {
     RCC_ClocksTypeDef clocks;
     RCC_GetClocksFreq(&clocks);
     usTicks = clocks.SYSCLK_Frequency / 1000000;
+    usTicksInv = ((1ULL << 32) + usTicks - 1) / usTicks;
+
+    // DWT cycle counter, runs without a debugger attached once trace is enabled
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
 }
 
 // SysTick
 void SysTick_Handler(void)
 {
+    sysTickCycles += usTicks * 1000;
     sysTickUptime++;
 }
 
-// Return system uptime in microseconds (rollover in 70minutes)
-uint32_t micros(void)
-{
-    register uint32_t ms, cycle_cnt;
-    do {
-        ms = sysTickUptime;
-        cycle_cnt = SysTick->VAL;
-    } while (ms != sysTickUptime);
-    return (ms * 1000) + (72000 - cycle_cnt) / 72;
-}
-
-// Return system uptime in milliseconds (rollover in 49 days)
-uint32_t millis(void)
-{
-    return sysTickUptime;
-}
-
 void systemInit(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
@@ -90,8 +85,9 @@ void systemInit(void)
     // Init cycle counter
     cycleCounterInit();
 
-    // SysTick
+    // SysTick, counts from here
     SysTick_Config(SystemCoreClock / 1000);
+    sysTickCycles = cycles();
 
     // Configure the rest of the stuff
 #ifndef FY90Q
@@ -102,39 +98,14 @@ void systemInit(void)
     delay(100);
 }
 
-#if 1
-void delayMicroseconds(uint32_t us)
-{
-    uint32_t now = micros();
-    while (micros() - now < us);
-}
-#else
+// cycle exact, up to ~59s
 void delayMicroseconds(uint32_t us)
 {
-    uint32_t elapsed = 0;
-    uint32_t lastCount = SysTick->VAL;
-
-    for (;;) {
-        register uint32_t current_count = SysTick->VAL;
-        uint32_t elapsed_us;
-
-        // measure the time elapsed since the last time we checked
-        elapsed += current_count - lastCount;
-        lastCount = current_count;
+    uint32_t start = cycles();
+    uint32_t wait = microsToCycles(us);
 
-        // convert to microseconds
-        elapsed_us = elapsed / usTicks;
-        if (elapsed_us >= us)
-            break;
-
-        // reduce the delay by the elapsed time
-        us -= elapsed_us;
-
-        // keep fractional microseconds for the next iteration
-        elapsed %= usTicks;
-    }
+    while (cycles() - start < wait);
 }
-#endif
 
 void delay(uint32_t ms)
 {
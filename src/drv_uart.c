@@ -9,20 +9,33 @@
 // Receive buffer, circular DMA
 volatile uint8_t rxBuffer[UART_BUFFER_SIZE];
 uint32_t rxDMAPos = 0;
+// Transmit buffer. Bytes from tail to head are queued or being sent, tail only moves once DMA is done with them.
+// Producers reserve a contiguous region, fill it in place and commit it. A region that doesn't fit at the end
+// of the buffer starts over at 0, txBufferWrap then marks where the older data ends.
 volatile uint8_t txBuffer[UART_BUFFER_SIZE];
-uint32_t txBufferTail = 0;
-uint32_t txBufferHead = 0;
+volatile uint32_t txBufferTail = 0;
+volatile uint32_t txBufferHead = 0;
+volatile uint32_t txBufferWrap = UART_BUFFER_SIZE;
+static uint32_t txDMALength = 0;
+static uint32_t txReserveStart = 0;
+static uint32_t txReserveLength = 0;
+static uint32_t txDropped = 0;
 
 static void uartTxDMA(void)
 {
-    DMA1_Channel4->CMAR = (uint32_t)&txBuffer[txBufferTail];
-    if (txBufferHead > txBufferTail) {
-        DMA1_Channel4->CNDTR = txBufferHead - txBufferTail;
-        txBufferTail = txBufferHead;
-    } else {
-        DMA1_Channel4->CNDTR = UART_BUFFER_SIZE - txBufferTail;
+    if (txBufferTail == txBufferWrap) {
         txBufferTail = 0;
+        txBufferWrap = UART_BUFFER_SIZE;
     }
+    if (txBufferHead == txBufferTail)
+        return;
+
+    if (txBufferHead > txBufferTail)
+        txDMALength = txBufferHead - txBufferTail;
+    else
+        txDMALength = txBufferWrap - txBufferTail;
+    DMA1_Channel4->CMAR = (uint32_t)&txBuffer[txBufferTail];
+    DMA1_Channel4->CNDTR = txDMALength;
 
     DMA_Cmd(DMA1_Channel4, ENABLE);
 }
@@ -32,8 +45,9 @@ void DMA1_Channel4_IRQHandler(void)
     DMA_ClearITPendingBit(DMA1_IT_TC4);
     DMA_Cmd(DMA1_Channel4, DISABLE);
 
-    if (txBufferHead != txBufferTail)
-        uartTxDMA();
+    txBufferTail += txDMALength;
+    txDMALength = 0;
+    uartTxDMA();
 }
 
 void uartInit(uint32_t speed)
@@ -99,6 +113,11 @@ void uartInit(uint32_t speed)
     DMA_Init(DMA1_Channel4, &DMA_InitStructure);
     DMA_ITConfig(DMA1_Channel4, DMA_IT_TC, ENABLE);
     DMA1_Channel4->CNDTR = 0;
+    txBufferTail = 0;
+    txBufferHead = 0;
+    txBufferWrap = UART_BUFFER_SIZE;
+    txDMALength = 0;
+    txReserveLength = 0;
     USART_DMACmd(USART1, USART_DMAReq_Tx, ENABLE);
 
     USART_Cmd(USART1, ENABLE);
@@ -132,30 +151,122 @@ uint8_t uartReadPoll(void)
     return uartRead();
 }
 
-void uartWrite(uint8_t ch)
+// largest region uartTxReserve() can currently hand out
+uint16_t uartTxFree(void)
+{
+    uint32_t head = txBufferHead;
+    uint32_t tail = txBufferTail;
+    uint32_t end;
+
+    if (head == tail)
+        return UART_BUFFER_SIZE - 1;
+    if (head < tail)
+        return tail - head - 1;
+    // head may only reach the end of the buffer if that doesn't make it equal to tail
+    end = UART_BUFFER_SIZE - head - (tail == 0 ? 1 : 0);
+    return (tail > 0 && tail - 1 > end) ? tail - 1 : end;
+}
+
+// Reserve len contiguous bytes to be filled in place. Returns NULL, and counts the bytes as dropped,
+// if there is not enough room. Only one reservation can be open at a time.
+uint8_t *uartTxReserve(uint16_t len)
+{
+    uint32_t head = txBufferHead;
+    uint32_t tail = txBufferTail;
+
+    txReserveLength = 0;
+    if (len == 0)
+        return NULL;
+
+    // nothing queued and nothing in flight, start over at the beginning for the most room
+    if (head == tail) {
+        txBufferTail = txBufferHead = head = tail = 0;
+    }
+
+    if (head < tail) {
+        if (head + len >= tail) {
+            txDropped += len;
+            return NULL;
+        }
+        txReserveStart = head;
+    } else if (head + len < UART_BUFFER_SIZE || (head + len == UART_BUFFER_SIZE && tail > 0)) {
+        txReserveStart = head;
+    } else if (len < tail) {
+        txReserveStart = 0;
+    } else {
+        txDropped += len;
+        return NULL;
+    }
+
+    txReserveLength = len;
+    return (uint8_t *)&txBuffer[txReserveStart];
+}
+
+// Queue the first len bytes of the open reservation for transmission
+void uartTxCommit(uint16_t len)
 {
-    txBuffer[txBufferHead] = ch;
-    txBufferHead = (txBufferHead + 1) % UART_BUFFER_SIZE;
+    if (len > txReserveLength)
+        len = txReserveLength;
+    txReserveLength = 0;
+    if (len == 0)
+        return;
 
+    // DMA completion moves tail and wrap, don't let it see half an update
+    __disable_irq();
+    if (txReserveStart != txBufferHead)
+        txBufferWrap = txBufferHead;
+    txBufferHead = (txReserveStart + len) % UART_BUFFER_SIZE;
     // if DMA wasn't enabled, fire it up
     if (!(DMA1_Channel4->CCR & 1))
         uartTxDMA();
+    __enable_irq();
+}
+
+uint32_t uartGetTxDropped(void)
+{
+    return txDropped;
+}
+
+// drops the byte if the buffer is full
+void uartWrite(uint8_t ch)
+{
+    uint8_t *p = uartTxReserve(1);
+
+    if (p) {
+        *p = ch;
+        uartTxCommit(1);
+    }
 }
 
+// waits for room instead of dropping, for CLI output
 void uartPrint(char *str)
 {
-    while (*str)
+    while (*str) {
+        while (!uartTxFree());
         uartWrite(*(str++));
+    }
 }
 
 /* -------------------------- UART2 (Spektrum, GPS) ----------------------------- */
 uartReceiveCallbackPtr uart2Callback = NULL;
 #define UART2_BUFFER_SIZE    128
-
+#define UART2_RX_BUFFER_SIZE 256
+#define UART2_IDLE_QUEUE     8       // frame ends between two uart2Poll() calls, power of 2
+
+// Receive buffer, circular DMA. Bytes are handed to uart2Callback from the main loop by uart2Poll()
+volatile uint8_t rx2Buffer[UART2_RX_BUFFER_SIZE];
+uint32_t rx2DMAPos = 0;
+// DMA positions of the idle lines, i.e. frame ends, not handed out by uart2Poll() yet. Written by the ISR at head,
+// read from the main loop at tail, so several frames arriving during a long loop each keep their end
+static volatile uint16_t rx2IdlePos[UART2_IDLE_QUEUE];
+static volatile uint8_t rx2IdleHead = 0;
+static uint8_t rx2IdleTail = 0;
 volatile uint8_t tx2Buffer[UART2_BUFFER_SIZE];
 uint32_t tx2BufferTail = 0;
 uint32_t tx2BufferHead = 0;
 bool uart2RxOnly = false;
+static uint16_t uart2StopBits = USART_StopBits_1;
+static uint16_t uart2Parity = USART_Parity_No;
 
 static void uart2Open(uint32_t speed)
 {
@@ -163,19 +274,28 @@ static void uart2Open(uint32_t speed)
 
     USART_StructInit(&USART_InitStructure);
     USART_InitStructure.USART_BaudRate = speed;
-    USART_InitStructure.USART_WordLength = USART_WordLength_8b;
-    USART_InitStructure.USART_StopBits = USART_StopBits_1;
-    USART_InitStructure.USART_Parity = USART_Parity_No;
+    // parity bit counts as the 9th data bit
+    USART_InitStructure.USART_WordLength = uart2Parity == USART_Parity_No ? USART_WordLength_8b : USART_WordLength_9b;
+    USART_InitStructure.USART_StopBits = uart2StopBits;
+    USART_InitStructure.USART_Parity = uart2Parity;
     USART_InitStructure.USART_Mode = USART_Mode_Rx | (uart2RxOnly ? 0 : USART_Mode_Tx);
     USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
     USART_Init(USART2, &USART_InitStructure);
     USART_Cmd(USART2, ENABLE);
 }
 
+// frame format for the following uart2Init(), default is 8N1
+void uart2SetFormat(uint16_t stopBits, uint16_t parity)
+{
+    uart2StopBits = stopBits;
+    uart2Parity = parity;
+}
+
 void uart2Init(uint32_t speed, uartReceiveCallbackPtr func, bool rxOnly)
 {
     NVIC_InitTypeDef NVIC_InitStructure;
     GPIO_InitTypeDef GPIO_InitStructure;
+    DMA_InitTypeDef DMA_InitStructure;
 
     RCC_APB1PeriphClockCmd(RCC_APB1Periph_USART2, ENABLE);
 
@@ -198,11 +318,32 @@ void uart2Init(uint32_t speed, uartReceiveCallbackPtr func, bool rxOnly)
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
     GPIO_Init(GPIOA, &GPIO_InitStructure);
 
+    // Receive DMA into a circular buffer
+    DMA_DeInit(DMA1_Channel6);
+    DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+    DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+    DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART2->DR;
+    DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)rx2Buffer;
+    DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+    DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    DMA_InitStructure.DMA_BufferSize = UART2_RX_BUFFER_SIZE;
+    DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+    DMA_Init(DMA1_Channel6, &DMA_InitStructure);
+
+    DMA_Cmd(DMA1_Channel6, ENABLE);
+    USART_DMACmd(USART2, USART_DMAReq_Rx, ENABLE);
+    rx2DMAPos = DMA_GetCurrDataCounter(DMA1_Channel6);
+    rx2IdleHead = rx2IdleTail = 0;
+
+    uart2Callback = func;
     uart2Open(speed);
-    USART_ITConfig(USART2, USART_IT_RXNE, ENABLE);
+    // only the idle line interrupts on receive, to mark frame ends
+    USART_ITConfig(USART2, USART_IT_IDLE, ENABLE);
     if (!rxOnly)
         USART_ITConfig(USART2, USART_IT_TXE, ENABLE);
-    uart2Callback = func;
 }
 
 void uart2ChangeBaud(uint32_t speed)
@@ -226,13 +367,43 @@ bool uart2TransmitEmpty(void)
     return tx2BufferTail == tx2BufferHead;
 }
 
+// Hand everything received since the last call to uart2Callback, followed by UART_FRAME_END
+// where the line went idle. Called from the main loop.
+void uart2Poll(void)
+{
+    uint8_t ch;
+
+    if (!uart2Callback)
+        return;
+
+    for (;;) {
+        // idle is detected one character after the last byte, which may have been consumed by the previous call
+        while (rx2IdleTail != rx2IdleHead && rx2IdlePos[rx2IdleTail] == rx2DMAPos) {
+            rx2IdleTail = (rx2IdleTail + 1) & (UART2_IDLE_QUEUE - 1);
+            uart2Callback(UART_FRAME_END);
+        }
+        if (DMA_GetCurrDataCounter(DMA1_Channel6) == rx2DMAPos)
+            break;
+        ch = rx2Buffer[UART2_RX_BUFFER_SIZE - rx2DMAPos];
+        // go back around the buffer
+        if (--rx2DMAPos == 0)
+            rx2DMAPos = UART2_RX_BUFFER_SIZE;
+        uart2Callback(ch);
+    }
+}
+
 void USART2_IRQHandler(void)
 {
     uint16_t SR = USART2->SR;
 
-    if (SR & USART_IT_RXNE) {
-        if (uart2Callback)
-            uart2Callback(USART_ReceiveData(USART2));
+    if (SR & USART_FLAG_IDLE) {
+        // cleared by reading SR followed by DR
+        (void)USART2->DR;
+        // when full the main loop is far behind anyway, the parsers resync on the frames after that
+        if (((rx2IdleHead + 1) & (UART2_IDLE_QUEUE - 1)) != rx2IdleTail) {
+            rx2IdlePos[rx2IdleHead] = DMA_GetCurrDataCounter(DMA1_Channel6);
+            rx2IdleHead = (rx2IdleHead + 1) & (UART2_IDLE_QUEUE - 1);
+        }
     }
     if (SR & USART_FLAG_TXE) {
         if (tx2BufferTail != tx2BufferHead) {
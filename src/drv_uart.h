@@ -8,9 +8,15 @@ uint8_t uartRead(void);
 uint8_t uartReadPoll(void);
 void uartWrite(uint8_t ch);
 void uartPrint(char *str);
+uint16_t uartTxFree(void);
+uint8_t *uartTxReserve(uint16_t len);
+void uartTxCommit(uint16_t len);
+uint32_t uartGetTxDropped(void);
 
 // USART2 (GPS, Spektrum)
+void uart2SetFormat(uint16_t stopBits, uint16_t parity);
 void uart2Init(uint32_t speed, uartReceiveCallbackPtr func, bool rxOnly);
 void uart2ChangeBaud(uint32_t speed);
 bool uart2TransmitEmpty(void);
 void uart2Write(uint8_t ch);
+void uart2Poll(void);
@@ -0,0 +1,42 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "dshot.h"
+
+// Map a 1000..2000us motor pulse to DShot throttle. Anything at or below 1000 is motor stop (0).
+uint16_t dshotThrottle(uint16_t pulse)
+{
+    uint32_t throttle;
+
+    if (pulse <= 1000)
+        return 0;
+    throttle = DSHOT_MIN_THROTTLE + (uint32_t)(pulse - 1000) * (DSHOT_MAX_THROTTLE - DSHOT_MIN_THROTTLE) / 1000;
+    if (throttle > DSHOT_MAX_THROTTLE)
+        throttle = DSHOT_MAX_THROTTLE;
+    return throttle;
+}
+
+// 11 bit throttle, telemetry request bit, 4 bit checksum (xor of the three nibbles above it)
+uint16_t dshotPacket(uint16_t throttle, bool telemetry)
+{
+    uint16_t packet = (throttle << 1) | (telemetry ? 1 : 0);
+    uint16_t csum = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+
+    return (packet << 4) | csum;
+}
+
+// Write the compare values for one packet, MSB first, followed by the padding. stride is the distance
+// between consecutive bits in buffer, so several channels can be interleaved for a timer DMA burst.
+void dshotEncode(uint16_t packet, uint16_t *buffer, uint8_t stride)
+{
+    uint8_t i;
+
+    for (i = 0; i < DSHOT_FRAME_BITS; i++) {
+        *buffer = (packet & 0x8000) ? DSHOT_BIT_1 : DSHOT_BIT_0;
+        packet <<= 1;
+        buffer += stride;
+    }
+    for (i = 0; i < DSHOT_PAD_BITS; i++) {
+        *buffer = 0;
+        buffer += stride;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// DShot frame encoding. No hardware access in here so it can be built and tested on the host.
+
+#define DSHOT_FRAME_BITS        16
+#define DSHOT_PAD_BITS          2       // zero width pulses after the frame keep the line low until the next one
+#define DSHOT_BUFFER_LENGTH     (DSHOT_FRAME_BITS + DSHOT_PAD_BITS)
+#define DSHOT_BIT_TICKS         80      // timer ticks per bit
+#define DSHOT_BIT_0             30      // 37.5% high
+#define DSHOT_BIT_1             60      // 75% high
+#define DSHOT_MIN_THROTTLE      48      // 1..47 are special commands
+#define DSHOT_MAX_THROTTLE      2047
+
+uint16_t dshotThrottle(uint16_t pulse);
+uint16_t dshotPacket(uint16_t throttle, bool telemetry);
+void dshotEncode(uint16_t packet, uint16_t *buffer, uint8_t stride);
@@ -0,0 +1,152 @@
+#include "board.h"
+#include "mw.h"
+
+// Receiver link monitoring and failsafe stages.
+// Receiver drivers report with failsafeOnValidFrame()/failsafeOnGlitch() (safe from ISRs), computeRC() checks each
+// channel with failsafeCheckChannel(), and failsafeUpdate() runs in the 50Hz RC loop.
+// When the link is lost while armed, the last values are held for failsafe_delay. After that the copter returns home
+// if it has a GPS fix, home position and baro, otherwise it levels and descends at failsafe_throttle.
+// failsafe_off_delay into the descent the motors are disarmed.
+
+#define FAILSAFE_MIN_PULSE          885     // us, channel values outside this are not used
+#define FAILSAFE_MAX_PULSE          2115
+#define FAILSAFE_LINK_TICKS         2       // a frame within this many updates means the link is up
+#define FAILSAFE_RECOVERY_TICKS     10      // 0.2s of good link before control goes back to the pilot
+#define FAILSAFE_RTH_LAND_DISTANCE  3       // m from home where return to home hands over to landing
+
+int16_t failsafeCnt = 0;            // failsafeUpdate() calls (50Hz) since the last valid frame
+int16_t failsafeEvents = 0;         // times failsafe took over
+failsafe_t failsafe;
+static volatile uint16_t validFrames = 0;   // since the last frame rate sample
+
+void failsafeOnValidFrame(void)
+{
+    failsafeCnt = 0;
+    validFrames++;
+}
+
+void failsafeOnGlitch(void)
+{
+    failsafe.glitches++;
+}
+
+// receiver says it lost the link itself (sbus failsafe bit), it has already waited out its own hold time
+void failsafeOnRxFailsafe(void)
+{
+    if (feature(FEATURE_FAILSAFE) && failsafeCnt <= 5 * cfg.failsafe_delay)
+        failsafeCnt = 5 * cfg.failsafe_delay + 1;
+}
+
+// returns false if value must not be used
+bool failsafeCheckChannel(uint8_t chan, uint16_t value)
+{
+    uint32_t mask = (uint32_t)1 << chan;
+
+    if (value < FAILSAFE_MIN_PULSE || value > FAILSAFE_MAX_PULSE) {
+        // count going bad, not every read while it stays bad
+        if (failsafe.channelValid & mask)
+            failsafe.glitches++;
+        failsafe.channelValid &= ~mask;
+        return false;
+    }
+    failsafe.channelValid |= mask;
+    return true;
+}
+
+static bool failsafeCanReturnHome(void)
+{
+    return sensors(SENSOR_GPS) && sensors(SENSOR_BARO) && f.GPS_FIX && f.GPS_FIX_HOME && GPS_numSat >= 5;
+}
+
+static void failsafeSetStage(uint8_t stage)
+{
+    failsafe.stage = stage;
+    failsafe.stageTicks = 0;
+}
+
+void failsafeUpdate(void)
+{
+    static uint8_t rateTicks = 0;
+    static uint8_t recoveryTicks = 0;
+    uint8_t i;
+
+    if (++rateTicks == 50) {
+        rateTicks = 0;
+        failsafe.frameRate = validFrames;
+        validFrames = 0;
+    }
+
+    if (!feature(FEATURE_FAILSAFE))
+        return;
+
+    failsafeCnt++;
+    failsafe.stageTicks++;
+
+    if (failsafeCnt <= FAILSAFE_LINK_TICKS) {
+        // link is up. Holding is just the guard time, anything further waits for the link to settle
+        if (recoveryTicks < FAILSAFE_RECOVERY_TICKS)
+            recoveryTicks++;
+        if (failsafe.stage == FAILSAFE_HOLD || (failsafe.stage != FAILSAFE_IDLE && recoveryTicks == FAILSAFE_RECOVERY_TICKS))
+            failsafeSetStage(FAILSAFE_IDLE);
+    } else {
+        recoveryTicks = 0;
+        if (!f.ARMED) {
+            // Turn off "Ok To arm to prevent the motors from spinning after repowering the RX with low throttle and aux to arm
+            if (failsafeCnt > 5 * cfg.failsafe_delay)
+                f.OK_TO_ARM = 0;
+            if (failsafe.stage == FAILSAFE_HOLD)
+                failsafeSetStage(FAILSAFE_IDLE);
+            else if (failsafe.stage == FAILSAFE_RTH || failsafe.stage == FAILSAFE_LANDING)
+                failsafeSetStage(FAILSAFE_DISARMED);
+        } else {
+            switch (failsafe.stage) {
+            case FAILSAFE_IDLE:
+            case FAILSAFE_DISARMED:
+                failsafeSetStage(FAILSAFE_HOLD);
+                break;
+            case FAILSAFE_HOLD:
+                // after specified guard time after RC signal is lost (in 0.1sec)
+                if (failsafeCnt > 5 * cfg.failsafe_delay) {
+                    failsafeEvents++;
+                    failsafeSetStage(failsafeCanReturnHome() ? FAILSAFE_RTH : FAILSAFE_LANDING);
+                }
+                break;
+            case FAILSAFE_RTH:
+                if (!failsafeCanReturnHome() || GPS_distanceToHome <= FAILSAFE_RTH_LAND_DISTANCE)
+                    failsafeSetStage(FAILSAFE_LANDING);
+                break;
+            case FAILSAFE_LANDING:
+                // Turn OFF motors after specified Time (in 0.1sec)
+                if (failsafe.stageTicks > 5 * cfg.failsafe_off_delay) {
+                    f.ARMED = 0;        // This will prevent the copter to automatically rearm if failsafe shuts it down and prevents
+                    f.OK_TO_ARM = 0;    // to restart accidentely by just reconnect to the tx - you will have to switch off first to rearm
+                    failsafeSetStage(FAILSAFE_DISARMED);
+                }
+                break;
+            }
+        }
+    }
+
+    // Stabilize, and set Throttle to specified level. Return to home keeps the throttle it had for baro alt hold
+    if (failsafe.stage == FAILSAFE_RTH || failsafe.stage == FAILSAFE_LANDING) {
+        for (i = 0; i < 3; i++)
+            rcData[i] = cfg.midrc;
+        if (failsafe.stage == FAILSAFE_LANDING)
+            rcData[THROTTLE] = cfg.failsafe_throttle;
+    }
+}
+
+// called after rcOptions[] are set from the switches, failsafe stages override them
+void failsafeApplyModes(void)
+{
+    if (failsafe.stage != FAILSAFE_RTH && failsafe.stage != FAILSAFE_LANDING)
+        return;
+
+    rcOptions[BOXANGLE] = 1;
+    rcOptions[BOXHORIZON] = 0;
+    rcOptions[BOXPASSTHRU] = 0;
+    rcOptions[BOXAUTOTUNE] = 0;
+    rcOptions[BOXGPSHOLD] = 0;
+    rcOptions[BOXGPSHOME] = failsafe.stage == FAILSAFE_RTH;
+    rcOptions[BOXBARO] = failsafe.stage == FAILSAFE_RTH;
+}
@@ -83,7 +83,10 @@ void gpsInit(uint32_t baudrate)
     }
 
     // catch some GPS frames. TODO check this
-    delay(1000);
+    for (i = 0; i < 1000; i++) {
+        uart2Poll();
+        delay(1);
+    }
     if (GPS_Present)
         sensorsSet(SENSOR_GPS);
 }
@@ -266,6 +269,9 @@ void GPS_NewData(uint16_t c)
     int32_t dir;
     int16_t speed;
 
+    if (c == UART_FRAME_END)
+        return;
+
     if (GPS_newFrame(c)) {
         if (GPS_update == 1)
             GPS_update = 0;
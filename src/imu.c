@@ -5,7 +5,9 @@ int16_t gyroADC[3], accADC[3], accSmooth[3], magADC[3];
 float accLPFVel[3];
 int16_t acc_25deg = 0;
 int32_t  BaroAlt;
-int16_t  sonarAlt;           //to think about the unit
+uint32_t BaroTime;           // timestamp of the pressure sample BaroAlt came from, us
+int16_t  sonarAlt;           // cm, median filtered
+bool     sonarValid = false; // sonarAlt is in range and recent
 int32_t  EstAlt;             // in cm
 int16_t  BaroPID = 0;
 int32_t  AltHold;
@@ -354,15 +356,40 @@ void getEstimatedAltitude(void)
     int16_t accZ;
     static float vel = 0.0f;
     static int32_t lastBaroAlt;
+    static uint32_t lastBaroTime;
     float baroVel;
+    int32_t alt = BaroAlt;
+#ifdef SONAR
+    static int32_t sonarBaroOffset = 0;
+    static int32_t sonarBlend = 0;
+    static bool sonarWasValid = false;
+#endif
 
     if ((int32_t)(currentTime - deadLine) < UPDATE_INTERVAL)
         return;
     dTime = currentTime - deadLine;
     deadLine = currentTime;
 
+#ifdef SONAR
+    // near the ground sonar is used as altitude. The baro offset is tracked meanwhile so altitude
+    // continues from the same value when sonar drops out of range. When sonar comes back the step
+    // between both is faded out over a few updates instead of being applied at once
+    if (sensors(SENSOR_SONAR)) {
+        if (sonarValid) {
+            if (!sonarWasValid)
+                sonarBlend = BaroAlt - sonarBaroOffset - sonarAlt;
+            else
+                sonarBlend = sonarBlend * 3 / 4;
+            alt = sonarAlt + sonarBlend;
+            sonarBaroOffset = BaroAlt - alt;
+        } else
+            alt = BaroAlt - sonarBaroOffset;
+        sonarWasValid = sonarValid;
+    }
+#endif
+
     // **** Alt. Set Point stabilization PID ****
-    baroHistTab[baroHistIdx] = BaroAlt / 10;
+    baroHistTab[baroHistIdx] = alt / 10;
     baroHigh += baroHistTab[baroHistIdx];
     baroHigh -= baroHistTab[(baroHistIdx + 1) % cfg.baro_tab_size];
 
@@ -392,14 +419,18 @@ void getEstimatedAltitude(void)
     // Integrator - velocity, cm/sec
     vel += accZ * accVelScale * dTime;
 
-    baroVel = (EstAlt - lastBaroAlt) / (dTime / 1000000.0f);
-    baroVel = constrain(baroVel, -300, 300); // constrain baro velocity +/- 300cm/s
-    baroVel = applyDeadbandFloat(baroVel, 10); // to reduce noise near zero
-    lastBaroAlt = EstAlt;
-    debug[1] = baroVel;
-
-    // apply Complimentary Filter to keep near zero caluculated velocity based on baro velocity
-    vel = vel * cfg.baro_cf + baroVel * (1.0f - cfg.baro_cf);
+    // baro velocity is taken over the sample timestamps, not loop time, and only when there was a new sample
+    if (BaroTime != lastBaroTime) {
+        baroVel = (EstAlt - lastBaroAlt) / ((BaroTime - lastBaroTime) / 1000000.0f);
+        baroVel = constrain(baroVel, -300, 300); // constrain baro velocity +/- 300cm/s
+        baroVel = applyDeadbandFloat(baroVel, 10); // to reduce noise near zero
+        lastBaroAlt = EstAlt;
+        lastBaroTime = BaroTime;
+        debug[1] = baroVel;
+
+        // apply Complimentary Filter to keep near zero caluculated velocity based on baro velocity
+        vel = vel * cfg.baro_cf + baroVel * (1.0f - cfg.baro_cf);
+    }
     // vel = constrain(vel, -300, 300); // constrain velocity +/- 300cm/s
     debug[2] = vel;
     // debug[3] = applyDeadbandFloat(vel, 5);
@@ -4,12 +4,16 @@
 extern uint8_t useServo;
 extern rcReadRawDataPtr rcReadRawFunc;
 
-// two receiver read functions
+// receiver read functions
 extern uint16_t pwmReadRawRC(uint8_t chan);
 extern uint16_t spektrumReadRawRC(uint8_t chan);
+extern uint16_t sbusReadRawRC(uint8_t chan);
+extern uint16_t mspReadRawRC(uint8_t chan);
 
 static void _putc(void *p, char c)
 {
+    // printf is CLI output, wait for room rather than drop
+    while (!uartTxFree());
     uartWrite(c);
 }
 
@@ -47,6 +51,11 @@ int main(void)
     checkFirstTime(false);
     readEEPROM();
 
+#ifndef FY90Q
+    // bus was started at 400kHz by systemInit(), switch to configured speed before sensor detection
+    i2cSetClockSpeed(cfg.i2c_speed);
+#endif
+
     // configure power ADC
     if (cfg.power_adc_channel > 0 && (cfg.power_adc_channel == 1 || cfg.power_adc_channel == 9))
         adc_params.powerAdcChannel = cfg.power_adc_channel;
@@ -71,11 +80,17 @@ int main(void)
     if (feature(FEATURE_SPEKTRUM)) {
         spektrumInit();
         rcReadRawFunc = spektrumReadRawRC;
+    } else if (feature(FEATURE_SBUS)) {
+        sbusInit();
+        rcReadRawFunc = sbusReadRawRC;
     } else {
-        // spektrum and GPS are mutually exclusive
+        // spektrum/sbus and GPS are mutually exclusive
         // Optional GPS - available in both PPM and PWM input mode, in PWM input, reduces number of available channels by 2.
         if (feature(FEATURE_GPS))
             gpsInit(cfg.gps_baudrate);
+        // serial RX comes in over the MSP port
+        if (feature(FEATURE_RX_MSP))
+            rcReadRawFunc = mspReadRawRC;
     }
 #ifdef SONAR
     // sonar stuff only works with PPM
@@ -86,16 +101,20 @@ int main(void)
 #endif
 
     mixerInit(); // this will set useServo var depending on mixer type
-    // when using airplane/wing mixer, servo/motor outputs are remapped
-    if (cfg.mixerConfiguration == MULTITYPE_AIRPLANE || cfg.mixerConfiguration == MULTITYPE_FLYING_WING)
+    // when using airplane/wing/heli mixer, servo/motor outputs are remapped
+    if (cfg.mixerConfiguration == MULTITYPE_AIRPLANE || cfg.mixerConfiguration == MULTITYPE_FLYING_WING ||
+        cfg.mixerConfiguration == MULTITYPE_HELI_120_CCPM || cfg.mixerConfiguration == MULTITYPE_HELI_90_DEG)
         pwm_params.airplane = true;
     else
         pwm_params.airplane = false;
     pwm_params.useUART = feature(FEATURE_GPS);
     pwm_params.usePPM = feature(FEATURE_PPM);
-    pwm_params.enableInput = !feature(FEATURE_SPEKTRUM); // disable inputs if using spektrum
+    pwm_params.enableInput = !feature(FEATURE_SPEKTRUM) && !feature(FEATURE_SBUS) && !feature(FEATURE_RX_MSP); // disable inputs if using a serial receiver
     pwm_params.useServos = useServo;
     pwm_params.extraServos = cfg.gimbal_flags & GIMBAL_FORWARDAUX;
+    pwm_params.oneshot = feature(FEATURE_ONESHOT125);
+    pwm_params.dshotRate = feature(FEATURE_DSHOT) ? cfg.dshot_rate : 0;
+    pwm_params.useSonar = sensors(SENSOR_SONAR);
     pwm_params.motorPwmRate = cfg.motor_pwm_rate;
     pwm_params.servoPwmRate = cfg.servo_pwm_rate;
     switch (cfg.power_adc_channel) {
@@ -112,8 +131,11 @@ int main(void)
 
     pwmInit(&pwm_params);
 
-    // configure PWM/CPPM read function. spektrum will override that
-    rcReadRawFunc = pwmReadRawRC;
+    // configure PWM/CPPM read function unless spektrum/sbus set their own above
+    if (!rcReadRawFunc)
+        rcReadRawFunc = pwmReadRawRC;
+    for (i = 0; i < RC_CHANS; i++)
+        rcData[i] = 1502;
 
     LED1_ON;
     LED0_OFF;
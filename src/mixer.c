@@ -8,6 +8,40 @@ int16_t servo[8] = { 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500 };
 
 static motorMixer_t currentMixer[MAX_MOTORS];
 
+// currentMixer converted to fixed point once in mixerInit(), so mixTable() stays integer-only.
+// 1.0f == 1 << MIXER_SCALE_BITS. yaw_direction is folded into the yaw column.
+#define MIXER_SCALE_BITS 10
+#define MIXER_SCALE (1 << MIXER_SCALE_BITS)
+
+typedef struct motorMixerFixed_t {
+    int16_t throttle;
+    int16_t roll;
+    int16_t pitch;
+    int16_t yaw;
+} motorMixerFixed_t;
+
+static motorMixerFixed_t fixedMixer[MAX_MOTORS];
+
+// swashplate servos servo[3], servo[4], servo[6]: collective, roll and pitch share per servo, fixed point
+enum { HELI_COLL = 0, HELI_ROLL, HELI_PITCH };
+static const uint8_t heliServo[3] = { 3, 4, 6 };
+static int16_t swashMix[3][3];
+
+// per servo travel, built in mixerInit() from servotrim/servoendpoint_* and the tri_yaw_*, wing_* and gimbal_* settings
+typedef struct servoParam_t {
+    int16_t min;
+    int16_t middle;
+    int16_t max;
+    int8_t reverse;
+} servoParam_t;
+
+static servoParam_t servoConf[8];
+
+// motor command (us above minthrottle) for 0/16..16/16 of the thrust range, built from cfg.thrust_linear
+#define THRUST_LUT_BITS 4
+#define THRUST_LUT_SIZE ((1 << THRUST_LUT_BITS) + 1)
+static int16_t thrustLut[THRUST_LUT_SIZE];
+
 static const motorMixer_t mixerTri[] = {
     { 1.0f,  0.0f,  1.333333f,  0.0f },     // REAR
     { 1.0f, -1.0f, -0.666667f,  0.0f },     // RIGHT
@@ -125,12 +159,30 @@ const mixer_t mixers[] = {
     { 8, 0, mixerOctoFlatP },      // MULTITYPE_OCTOFLATP
     { 8, 0, mixerOctoFlatX },      // MULTITYPE_OCTOFLATX
     { 1, 1, NULL },                // * MULTITYPE_AIRPLANE
-    { 0, 1, NULL },                // * MULTITYPE_HELI_120_CCPM
-    { 0, 1, NULL },                // * MULTITYPE_HELI_90_DEG
+    { 1, 1, NULL },                // * MULTITYPE_HELI_120_CCPM
+    { 1, 1, NULL },                // * MULTITYPE_HELI_90_DEG
     { 4, 0, mixerVtail4 },         // MULTITYPE_VTAIL4
     { 0, 0, NULL },                // MULTITYPE_CUSTOM
 };
 
+static void mixerSetServo(int i, int16_t min, int16_t middle, int16_t max)
+{
+    servoConf[i].min = min;
+    servoConf[i].middle = middle;
+    servoConf[i].max = max;
+}
+
+static int16_t mixerToFixed(float value)
+{
+    return (int16_t)(value * MIXER_SCALE + (value < 0.0f ? -0.5f : 0.5f));
+}
+
+// drop the fraction, rounding to nearest (relies on arithmetic right shift for negatives)
+static int32_t mixerFromFixed(int32_t value)
+{
+    return (value + (MIXER_SCALE / 2)) >> MIXER_SCALE_BITS;
+}
+
 void mixerInit(void)
 {
     int i;
@@ -158,6 +210,62 @@ void mixerInit(void)
                 currentMixer[i] = mixers[cfg.mixerConfiguration].motor[i];
         }
     }
+
+    for (i = 0; i < numberMotor; i++) {
+        fixedMixer[i].throttle = mixerToFixed(currentMixer[i].throttle);
+        fixedMixer[i].roll = mixerToFixed(currentMixer[i].roll);
+        fixedMixer[i].pitch = mixerToFixed(currentMixer[i].pitch);
+        fixedMixer[i].yaw = mixerToFixed(cfg.yaw_direction * currentMixer[i].yaw);
+    }
+
+    memset(swashMix, 0, sizeof(swashMix));
+    if (cfg.mixerConfiguration == MULTITYPE_HELI_120_CCPM) {
+        // servos 120deg apart, left/right/rear at 300/60/180deg clockwise from the nose, rotated by heli_swash_phase
+        static const int16_t ccpmAngle[3] = { 300, 60, 180 };
+        for (i = 0; i < 3; i++) {
+            float rad = (ccpmAngle[i] + cfg.heli_swash_phase) * (M_PI / 180.0f);
+            swashMix[i][HELI_COLL] = MIXER_SCALE;
+            swashMix[i][HELI_ROLL] = mixerToFixed(sinf(rad));
+            swashMix[i][HELI_PITCH] = mixerToFixed(cosf(rad));
+        }
+    } else if (cfg.mixerConfiguration == MULTITYPE_HELI_90_DEG) {
+        // mechanically mixed swash, one servo per axis: roll, collective, pitch
+        swashMix[0][HELI_ROLL] = MIXER_SCALE;
+        swashMix[1][HELI_COLL] = MIXER_SCALE;
+        swashMix[2][HELI_PITCH] = MIXER_SCALE;
+    }
+
+    for (i = 0; i < 8; i++) {
+        servoConf[i].min = cfg.servoendpoint_low[i];
+        servoConf[i].middle = 1500;
+        servoConf[i].max = cfg.servoendpoint_high[i];
+    }
+    // the older per-mixer settings take the place of the generic middle and endpoints
+    if (cfg.mixerConfiguration == MULTITYPE_TRI)
+        mixerSetServo(5, cfg.tri_yaw_min, cfg.tri_yaw_middle, cfg.tri_yaw_max);
+    if (cfg.mixerConfiguration == MULTITYPE_FLYING_WING) {
+        mixerSetServo(0, cfg.wing_left_min, cfg.wing_left_mid, cfg.wing_left_max);
+        mixerSetServo(1, cfg.wing_right_min, cfg.wing_right_mid, cfg.wing_right_max);
+    }
+    if (cfg.mixerConfiguration == MULTITYPE_GIMBAL || feature(FEATURE_SERVO_TILT)) {
+        mixerSetServo(0, cfg.gimbal_pitch_min, cfg.gimbal_pitch_mid, cfg.gimbal_pitch_max);
+        mixerSetServo(1, cfg.gimbal_roll_min, cfg.gimbal_roll_mid, cfg.gimbal_roll_max);
+    }
+    // trim and reverse apply on top of either
+    for (i = 0; i < 8; i++) {
+        servoConf[i].middle += cfg.servotrim[i];
+        servoConf[i].reverse = cfg.servoreverse[i];
+    }
+
+    // thrust ~ (1 - k) * c + k * c^2 for command c in 0..1, solved for c at evenly spaced thrust
+    if (cfg.thrust_linear) {
+        float k = cfg.thrust_linear / 100.0f;
+        for (i = 0; i < THRUST_LUT_SIZE; i++) {
+            float t = (float)i / (THRUST_LUT_SIZE - 1);
+            float c = (sqrtf((1.0f - k) * (1.0f - k) + 4.0f * k * t) - (1.0f - k)) / (2.0f * k);
+            thrustLut[i] = c * (cfg.maxthrottle - cfg.minthrottle) + 0.5f;
+        }
+    }
 }
 
 void mixerLoadMix(int index)
@@ -177,38 +285,78 @@ void mixerLoadMix(int index)
     }
 }
 
+static bool servoNewFrame = false;
+
+// Write servo[index] to an output, moving at most cfg.servorate[index] us per servo frame.
+// CCRs are preloaded, so this runs every loop and the last write before the timer update is the one sent.
+static void writeServo(uint8_t output, uint8_t index)
+{
+    static int16_t current[8];
+    static int16_t lastFrame[8];
+    int16_t rate = cfg.servorate[index];
+
+    if (servoNewFrame)
+        lastFrame[index] = current[index];
+    if (rate && lastFrame[index])
+        current[index] = constrain(servo[index], lastFrame[index] - rate, lastFrame[index] + rate);
+    else
+        current[index] = servo[index];
+    pwmWriteServo(output, current[index]);
+}
+
 void writeServos(void)
 {
-    if (!useServo)
-        return;
+    int i;
 
-    switch (cfg.mixerConfiguration) {
-        case MULTITYPE_BI:
-            pwmWriteServo(0, servo[4]);
-            pwmWriteServo(1, servo[5]);
-            break;
+    // the update flag only advances the servorate limiter, the outputs are refreshed every loop
+    servoNewFrame = pwmServoFrameStart();
 
-        case MULTITYPE_TRI:
-            pwmWriteServo(0, servo[5]);
-            break;
+    if (useServo) {
+        switch (cfg.mixerConfiguration) {
+            case MULTITYPE_BI:
+                writeServo(0, 4);
+                writeServo(1, 5);
+                break;
 
-        case MULTITYPE_AIRPLANE:
+            case MULTITYPE_TRI:
+                writeServo(0, 5);
+                break;
 
-            break;
+            case MULTITYPE_HELI_120_CCPM:
+            case MULTITYPE_HELI_90_DEG:
+                for (i = 0; i < 4; i++)
+                    writeServo(i, i + 3);
+                break;
 
-        case MULTITYPE_FLYING_WING:
-        case MULTITYPE_GIMBAL:
-            pwmWriteServo(0, servo[0]);
-            pwmWriteServo(1, servo[1]);
-            break;
+            case MULTITYPE_AIRPLANE:
+                // air maps have 4 servos on PWM11..14, PPM adds 4 more on PWM5..8 which take the flaps
+                for (i = 0; i < 4; i++)
+                    writeServo(i, i + 3);
+                writeServo(4, 2);
+                break;
 
-        default:
-            // Two servos for SERVO_TILT, if enabled
-            if (feature(FEATURE_SERVO_TILT)) {
-                pwmWriteServo(0, servo[0]);
-                pwmWriteServo(1, servo[1]);
-            }
-            break;
+            case MULTITYPE_FLYING_WING:
+            case MULTITYPE_GIMBAL:
+                writeServo(0, 0);
+                writeServo(1, 1);
+                break;
+
+            default:
+                // Two servos for SERVO_TILT, if enabled
+                if (feature(FEATURE_SERVO_TILT)) {
+                    writeServo(0, 0);
+                    writeServo(1, 1);
+                }
+                break;
+        }
+    }
+
+    if (cfg.gimbal_flags & GIMBAL_FORWARDAUX) {
+        int offset = 0;
+        if (feature(FEATURE_SERVO_TILT))
+            offset = 2;
+        for (i = 0; i < 4; i++)
+            pwmWriteServo(i + offset, rcData[AUX1 + i]);
     }
 }
 
@@ -220,6 +368,8 @@ void writeMotors(void)
 
     for (i = 0; i < numberMotor; i++)
         pwmWriteMotor(i, motor[i]);
+    // OneShot outputs only go out now, all at once
+    pwmCompleteMotorUpdate();
 }
 
 void writeAllMotors(int16_t mc)
@@ -232,59 +382,183 @@ void writeAllMotors(int16_t mc)
     writeMotors();
 }
 
+// servo middle plus value in the servo's direction, limited to its travel
+static int16_t servoOutput(int i, int16_t value)
+{
+    return constrain(servoConf[i].middle + value * servoConf[i].reverse, servoConf[i].min, servoConf[i].max);
+}
+
+// Ramp a flap value towards its target by at most cfg.flapspeed per loop, 0 moves at once.
+static int16_t flapSlew(int16_t current, int16_t target)
+{
+    if (!cfg.flapspeed)
+        return target;
+    if (current < target)
+        return min(current + cfg.flapspeed, target);
+    return max(current - cfg.flapspeed, target);
+}
+
+/*
+    servo[2]    flaps
+    servo[3]    wing 1 (left aileron)
+    servo[4]    wing 2 (right aileron)
+    servo[5]    rudder
+    servo[6]    elevator
+    motor[0]    throttle, arming and mincheck are handled by mixTable()
+*/
 static void airplaneMixer(void)
 {
-#if 0
-    uint16_t servomid[8];
-    int16_t flaperons[2] = { 0, 0 };
+    static int16_t slowFlaps = 0;
+    static int16_t slowFlaperons = 0;
+    int16_t flaperon = 0;
+    int16_t roll, pitch, yaw;
+    int i;
 
-    for (i = 0; i < 8; i++) {
-        servomid[i] = 1500 + cfg.servotrim[i]; // servo center is 1500?
+    motor[0] = rcCommand[THROTTLE];
+
+    // flaps and flaperons follow an AUX channel, 0 = not used
+    if (cfg.flaps) {
+        slowFlaps = flapSlew(slowFlaps, rcData[AUX1 + cfg.flaps - 1] - cfg.midrc);
+        servo[2] = slowFlaps;
+    } else {
+        servo[2] = 0;
+    }
+    if (cfg.flaperons) {
+        slowFlaperons = flapSlew(slowFlaperons, rcData[AUX1 + cfg.flaperons - 1] - cfg.midrc);
+        flaperon = slowFlaperons;
     }
 
-    if (!f.ARMED)
-        motor[0] = cfg.mincommand; // Kill throttle when disarmed
-    else
-        motor[0] = rcData[THROTTLE];
+    if (f.PASSTHRU_MODE) {
+        // Direct passthru from RX
+        roll = rcCommand[ROLL];
+        pitch = rcCommand[PITCH];
+        yaw = rcCommand[YAW];
+    } else {
+        // Assisted modes (gyro only or gyro+acc according to AUX configuration in Gui)
+        roll = axisPID[ROLL];
+        pitch = axisPID[PITCH];
+        yaw = axisPID[YAW];
+    }
 
-    if (cfg.flaperons) {
-        
-        
+    // both ailerons droop together for flaperons, roll is split by servoreverse
+    servo[3] = roll + flaperon;
+    servo[4] = roll - flaperon;
+    servo[5] = yaw;
+    servo[6] = pitch;
+
+    for (i = 2; i < 7; i++)
+        servo[i] = servoOutput(i, servo[i]);
+}
+
+// 5 point curve at 0/25/50/75/100% stick, points in percent. pos 0..1000, result in 0.1%
+static int16_t curveLookup(const int8_t *curve, int16_t pos)
+{
+    int16_t seg = min(pos / 250, 3);
+    int16_t frac = pos - seg * 250;
+
+    return (curve[seg] * (250 - frac) + curve[seg + 1] * frac) / 25;
+}
+
+/*
+    servo[3], servo[4], servo[6]    swashplate, see swashMix
+    servo[5]                        tail rotor
+    motor[0]                        throttle from heli_throttle_curve, arming and mincheck are handled by mixTable()
+*/
+static void heliMixer(void)
+{
+    int32_t stick, collective;
+    int i;
+
+    // same stick scaling as annexCode(): [MINCHECK;2000] -> [0;1000]
+    stick = constrain(rcData[THROTTLE], cfg.mincheck, 2000);
+    stick = (stick - cfg.mincheck) * 1000 / (2000 - cfg.mincheck);
+
+    collective = curveLookup(cfg.heli_pitch_curve, stick) * cfg.heli_collective_throw / 1000;
+    // a flat throttle curve leaves the speed to the ESC governor
+    motor[0] = cfg.minthrottle + curveLookup(cfg.heli_throttle_curve, stick) * (cfg.maxthrottle - cfg.minthrottle) / 1000;
+
+    for (i = 0; i < 3; i++)
+        servo[heliServo[i]] = mixerFromFixed(swashMix[i][HELI_COLL] * collective + swashMix[i][HELI_ROLL] * axisPID[ROLL] + swashMix[i][HELI_PITCH] * axisPID[PITCH]);
+
+    // tail gyro is the yaw rate loop, collective feeds forward the extra main rotor torque
+    servo[5] = cfg.yaw_direction * axisPID[YAW] + collective * cfg.heli_tail_revomix / 100;
+
+    for (i = 3; i < 7; i++)
+        servo[i] = servoOutput(i, servo[i]);
+}
+
+// Map a motor command meant as linear thrust to the command that actually gives it.
+static int16_t thrustLinearize(int16_t value)
+{
+    int32_t range = cfg.maxthrottle - cfg.minthrottle;
+    int32_t pos, seg, frac;
+
+    if (range <= 0)
+        return value;
+
+    // position in the table with 8 fractional bits
+    pos = (constrain(value - cfg.minthrottle, 0, range) << (THRUST_LUT_BITS + 8)) / range;
+    seg = min(pos >> 8, THRUST_LUT_SIZE - 2);
+    frac = pos - (seg << 8);
+
+    return cfg.minthrottle + thrustLut[seg] + (((thrustLut[seg + 1] - thrustLut[seg]) * frac) >> 8);
+}
+
+// Mix throttle and PID for every motor in integer math. If the PID part alone needs more room than
+// minthrottle..maxthrottle, its authority is scaled down to fit; the result is then shifted back inside
+// the range from whichever end saturated, so attitude corrections survive at both full and low throttle.
+static void mixMotors(void)
+{
+    int32_t pid[MAX_MOTORS];
+    int32_t pidMin, pidMax, pidRange, span;
+    int32_t maxMotor, minMotor;
+    int32_t throttle = rcCommand[THROTTLE];
+    uint32_t i;
+
+    // battery sag: scale throttle above minthrottle and PID by nominal / measured voltage
+    if (vbatCompensation != 1024)
+        throttle = cfg.minthrottle + (((throttle - cfg.minthrottle) * vbatCompensation + 512) >> 10);
+
+    pidMin = pidMax = 0;
+    for (i = 0; i < numberMotor; i++) {
+        pid[i] = mixerFromFixed(axisPID[PITCH] * fixedMixer[i].pitch + axisPID[ROLL] * fixedMixer[i].roll + axisPID[YAW] * fixedMixer[i].yaw);
+        if (vbatCompensation != 1024)
+            pid[i] = (pid[i] * vbatCompensation + 512) >> 10;
+        if (i == 0 || pid[i] < pidMin)
+            pidMin = pid[i];
+        if (i == 0 || pid[i] > pidMax)
+            pidMax = pid[i];
     }
 
-    if (cfg.flaps) {
-        int16_t flap = 1500 - constrain(rcData[cfg.flaps], cfg.servoendpoint_low[2], cfg.servoendpoint_high[2]);
-        static int16_t slowFlaps = flap;
-
-        if (cfg.flapspeed) {
-            if (slowFlaps < flap) {
-                slowFlaps += cfg.flapspeed;
-            } else if (slowFlaps > flap) {
-                slowFlaps -= cfg.flapspeed;
-            }
-        } else {
-            slowFlaps = flap;
-        }
-        servo[2] = servomid[2] + (slowFlaps * cfg.servoreverse[2]);
+    pidRange = pidMax - pidMin;
+    span = cfg.maxthrottle - cfg.minthrottle;
+    if (pidRange > span && span > 0) {
+        for (i = 0; i < numberMotor; i++)
+            pid[i] = (pid[i] * span + (pid[i] < 0 ? -pidRange : pidRange) / 2) / pidRange;
+    }
+
+    maxMotor = minMotor = motor[0] = mixerFromFixed(throttle * fixedMixer[0].throttle) + pid[0];
+    for (i = 1; i < numberMotor; i++) {
+        motor[i] = mixerFromFixed(throttle * fixedMixer[i].throttle) + pid[i];
+        if (motor[i] > maxMotor)
+            maxMotor = motor[i];
+        if (motor[i] < minMotor)
+            minMotor = motor[i];
     }
 
-    if (f.PASSTHRU_MODE) { // Direct passthru from RX
-        servo[3] = servomid[3] + ((rcCommand[ROLL] + flapperons[0]) * cfg.servoreverse[3]);     //   Wing 1
-        servo[4] = servomid[4] + ((rcCommand[ROLL] + flapperons[1]) * cfg.servoreverse[4]);     //   Wing 2
-        servo[5] = servomid[5] + (rcCommand[YAW] * cfg.servoreverse[5]);                        //   Rudder
-        servo[6] = servomid[6] + (rcCommand[PITCH] * cfg.servoreverse[6]);                      //   Elevator
-    } else { // Assisted modes (gyro only or gyro+acc according to AUX configuration in Gui
-        servo[3] = (servomid[3] + ((axisPID[ROLL] + flapperons[0]) * cfg.servoreverse[3]));     //   Wing 1
-        servo[4] = (servomid[4] + ((axisPID[ROLL] + flapperons[1]) * cfg.servoreverse[4]));     //   Wing 2
-        servo[5] = (servomid[5] + (axisPID[YAW] * cfg.servoreverse[5]));                        //   Rudder
-        servo[6] = (servomid[6] + (axisPID[PITCH] * cfg.servoreverse[6]));                      //   Elevator
+    // this is a way to still have good gyro corrections if at least one motor reaches its limit.
+    // Lifting the low end adds thrust at zero stick, so that part is airmode only
+    if (maxMotor > cfg.maxthrottle) {
+        for (i = 0; i < numberMotor; i++)
+            motor[i] -= maxMotor - cfg.maxthrottle;
+    } else if (minMotor < cfg.minthrottle && cfg.mixer_airmode) {
+        for (i = 0; i < numberMotor; i++)
+            motor[i] += cfg.minthrottle - minMotor;
     }
-#endif
 }
 
 void mixTable(void)
 {
-    int16_t maxMotor;
     uint32_t i;
 
     if (numberMotor > 3) {
@@ -294,29 +568,33 @@ void mixTable(void)
 
     // motors for non-servo mixes
     if (numberMotor > 1)
-        for (i = 0; i < numberMotor; i++)
-            motor[i] = rcCommand[THROTTLE] * currentMixer[i].throttle + axisPID[PITCH] * currentMixer[i].pitch + axisPID[ROLL] * currentMixer[i].roll + cfg.yaw_direction * axisPID[YAW] * currentMixer[i].yaw;
+        mixMotors();
 
     // airplane / servo mixes
     switch (cfg.mixerConfiguration) {
         case MULTITYPE_BI:
-            servo[4] = constrain(1500 + (cfg.yaw_direction * axisPID[YAW]) + axisPID[PITCH], 1020, 2000);   //LEFT
-            servo[5] = constrain(1500 + (cfg.yaw_direction * axisPID[YAW]) - axisPID[PITCH], 1020, 2000);   //RIGHT
+            servo[4] = servoOutput(4, (cfg.yaw_direction * axisPID[YAW]) + axisPID[PITCH]);     //LEFT
+            servo[5] = servoOutput(5, (cfg.yaw_direction * axisPID[YAW]) - axisPID[PITCH]);     //RIGHT
             break;
 
         case MULTITYPE_TRI:
-            servo[5] = constrain(cfg.tri_yaw_middle + cfg.yaw_direction * axisPID[YAW], cfg.tri_yaw_min, cfg.tri_yaw_max); //REAR
+            servo[5] = servoOutput(5, cfg.yaw_direction * axisPID[YAW]);    //REAR
             break;
 
         case MULTITYPE_GIMBAL:
-            servo[0] = constrain(cfg.gimbal_pitch_mid + cfg.gimbal_pitch_gain * angle[PITCH] / 16 + rcCommand[PITCH], cfg.gimbal_pitch_min, cfg.gimbal_pitch_max);
-            servo[1] = constrain(cfg.gimbal_roll_mid + cfg.gimbal_roll_gain * angle[ROLL] / 16 + rcCommand[ROLL], cfg.gimbal_roll_min, cfg.gimbal_roll_max);
+            servo[0] = servoOutput(0, cfg.gimbal_pitch_gain * angle[PITCH] / 16 + rcCommand[PITCH]);
+            servo[1] = servoOutput(1, cfg.gimbal_roll_gain * angle[ROLL] / 16 + rcCommand[ROLL]);
             break;
 
         case MULTITYPE_AIRPLANE:
             airplaneMixer();
             break;
 
+        case MULTITYPE_HELI_120_CCPM:
+        case MULTITYPE_HELI_90_DEG:
+            heliMixer();
+            break;
+
         case MULTITYPE_FLYING_WING:
             motor[0] = rcCommand[THROTTLE];
             if (f.PASSTHRU_MODE) {
@@ -328,48 +606,36 @@ void mixTable(void)
                 servo[0]  = cfg.pitch_direction_l * axisPID[PITCH] + cfg.roll_direction_l * axisPID[ROLL];
                 servo[1]  = cfg.pitch_direction_r * axisPID[PITCH] + cfg.roll_direction_r * axisPID[ROLL];
             }
-            servo[0] = constrain(servo[0] + cfg.wing_left_mid, cfg.wing_left_min, cfg.wing_left_max);
-            servo[1] = constrain(servo[1] + cfg.wing_right_mid, cfg.wing_right_min, cfg.wing_right_max);
+            servo[0] = servoOutput(0, servo[0]);
+            servo[1] = servoOutput(1, servo[1]);
             break;
     }
 
     // do camstab
     if (feature(FEATURE_SERVO_TILT)) {
-        uint16_t aux[2] = { 0, 0 };
+        int16_t aux[2] = { 0, 0 };
 
         if ((cfg.gimbal_flags & GIMBAL_NORMAL) || (cfg.gimbal_flags & GIMBAL_TILTONLY))
             aux[0] = rcData[AUX3] - cfg.midrc;
         if (!(cfg.gimbal_flags & GIMBAL_DISABLEAUX34))
             aux[1] = rcData[AUX4] - cfg.midrc;
 
-        servo[0] = cfg.gimbal_pitch_mid + aux[0];
-        servo[1] = cfg.gimbal_roll_mid + aux[1];
+        servo[0] = aux[0];
+        servo[1] = aux[1];
 
         if (rcOptions[BOXCAMSTAB]) {
             servo[0] += cfg.gimbal_pitch_gain * angle[PITCH] / 16;
             servo[1] += cfg.gimbal_roll_gain * angle[ROLL]  / 16;
         }
 
-        servo[0] = constrain(servo[0], cfg.gimbal_pitch_min, cfg.gimbal_pitch_max);
-        servo[1] = constrain(servo[1], cfg.gimbal_roll_min, cfg.gimbal_roll_max);
-    }
-
-    if (cfg.gimbal_flags & GIMBAL_FORWARDAUX) {
-        int offset = 0;
-        if (feature(FEATURE_SERVO_TILT))
-            offset = 2;
-        for (i = 0; i < 4; i++)
-            pwmWriteServo(i + offset, rcData[AUX1 + i]);
+        servo[0] = servoOutput(0, servo[0]);
+        servo[1] = servoOutput(1, servo[1]);
     }
 
-    maxMotor = motor[0];
-    for (i = 1; i < numberMotor; i++)
-        if (motor[i] > maxMotor)
-            maxMotor = motor[i];
     for (i = 0; i < numberMotor; i++) {
-        if (maxMotor > cfg.maxthrottle)     // this is a way to still have good gyro corrections if at least one motor reaches its max.
-            motor[i] -= maxMotor - cfg.maxthrottle;
         motor[i] = constrain(motor[i], cfg.minthrottle, cfg.maxthrottle);
+        if (cfg.thrust_linear)
+            motor[i] = thrustLinearize(motor[i]);
         if ((rcData[THROTTLE]) < cfg.mincheck) {
             if (!feature(FEATURE_MOTOR_STOP))
                 motor[i] = cfg.minthrottle;
@@ -13,17 +13,21 @@ int16_t headFreeModeHold;
 
 int16_t annex650_overrun_count = 0;
 uint8_t vbat;                   // battery voltage in 0.1V steps
+uint16_t vbatCompensation = 1024;   // mixer gain for battery sag, 1024 = 1.0
+int16_t amperage;               // current in 0.01A steps
+uint32_t mAhDrawn;              // integrated current since power up
 int16_t telemTemperature1;      // gyro sensor temperature
 
-int16_t failsafeCnt = 0;
-int16_t failsafeEvents = 0;
-int16_t rcData[8] = { 1502, 1502, 1502, 1502, 1502, 1502, 1502, 1502 }; // interval [1000;2000]
+int16_t rcData[RC_CHANS];       // interval [1000;2000]
 int16_t rcCommand[4];           // interval [1000;2000] for THROTTLE and [-500;+500] for ROLL/PITCH/YAW 
 int16_t lookupPitchRollRC[6];   // lookup table for expo & RC rate PITCH+ROLL
 int16_t lookupThrottleRC[11];   // lookup table for expo & mid THROTTLE
+uint8_t lookupThrottlePID[3][3][11];    // P/I/D percent per axis over throttle 1000..2000 from the tpa curves, see readEEPROM()
+uint8_t lookupThrottleDyn[11];          // dynThrPID ramp in percent over throttle 1000..2000, ROLL+PITCH P/D only
 rcReadRawDataPtr rcReadRawFunc = NULL;  // receive data from default (pwm/ppm) or additional (spek/sbus/?? receiver drivers)
 
 uint8_t dynP8[3], dynI8[3], dynD8[3];
+uint8_t dynLevelP8[2], dynLevelI8[2];   // P8/I8[PIDLEVEL] after the ROLL/PITCH tpa curves, dynThrPID is not applied
 uint8_t rcOptions[CHECKBOXITEMS];
 
 int16_t axisPID[3];
@@ -73,8 +77,6 @@ void blinkLED(uint8_t num, uint8_t wait, uint8_t repeat)
     }
 }
 
-#define BREAKPOINT 1500
-
 // this code is executed at each loop and won't interfere with control loop if it lasts less than 650 microseconds
 void annexCode(void)
 {
@@ -82,21 +84,24 @@ void annexCode(void)
     uint16_t tmp, tmp2;
     static uint8_t buzzerFreq;  //delay between buzzer ring
     static uint8_t vbatTimer = 0;
-    uint8_t axis, prop1, prop2;
+    uint8_t axis, prop1;
+    uint8_t tpa[3][3], dyn;
     static uint8_t ind = 0;
     uint16_t vbatRaw = 0;
     static uint16_t vbatRawArray[8];
     uint8_t i;
 
-    // PITCH & ROLL only dynamic PID adjustemnt,  depending on throttle value
-    if (rcData[THROTTLE] < BREAKPOINT) {
-        prop2 = 100;
-    } else {
-        if (rcData[THROTTLE] < 2000) {
-            prop2 = 100 - (uint16_t) cfg.dynThrPID * (rcData[THROTTLE] - BREAKPOINT) / (2000 - BREAKPOINT);
-        } else {
-            prop2 = 100 - cfg.dynThrPID;
-        }
+    // dynamic PID adjustemnt, depending on throttle value
+    tmp = constrain(rcData[THROTTLE], 1000, 2000) - 1000;
+    tmp2 = min(tmp / 100, 9);
+    for (axis = 0; axis < 3; axis++) {
+        for (i = 0; i < 3; i++)
+            tpa[axis][i] = lookupThrottlePID[axis][i][tmp2] + (tmp - tmp2 * 100) * (lookupThrottlePID[axis][i][tmp2 + 1] - lookupThrottlePID[axis][i][tmp2]) / 100;
+    }
+    dyn = lookupThrottleDyn[tmp2] + (tmp - tmp2 * 100) * (lookupThrottleDyn[tmp2 + 1] - lookupThrottleDyn[tmp2]) / 100;
+    for (axis = 0; axis < 2; axis++) {
+        dynLevelP8[axis] = (uint16_t) cfg.P8[PIDLEVEL] * tpa[axis][0] / 100;
+        dynLevelI8[axis] = (uint16_t) cfg.I8[PIDLEVEL] * tpa[axis][1] / 100;
     }
 
     for (axis = 0; axis < 3; axis++) {
@@ -113,7 +118,9 @@ void annexCode(void)
             tmp2 = tmp / 100;
             rcCommand[axis] = lookupPitchRollRC[tmp2] + (tmp - tmp2 * 100) * (lookupPitchRollRC[tmp2 + 1] - lookupPitchRollRC[tmp2]) / 100;
             prop1 = 100 - (uint16_t) cfg.rollPitchRate * tmp / 500;
-            prop1 = (uint16_t) prop1 *prop2 / 100;
+            dynP8[axis] = (uint32_t) cfg.P8[axis] * prop1 * tpa[axis][0] * dyn / 1000000;
+            dynI8[axis] = (uint16_t) cfg.I8[axis] * tpa[axis][1] / 100;
+            dynD8[axis] = (uint32_t) cfg.D8[axis] * prop1 * tpa[axis][2] * dyn / 1000000;
         } else {                // YAW
             if (cfg.yawdeadband) {
                 if (tmp > cfg.yawdeadband) {
@@ -124,9 +131,10 @@ void annexCode(void)
             }
             rcCommand[axis] = tmp;
             prop1 = 100 - (uint16_t) cfg.yawRate * tmp / 500;
+            dynP8[axis] = (uint32_t) cfg.P8[axis] * prop1 * tpa[axis][0] / 10000;
+            dynI8[axis] = (uint16_t) cfg.I8[axis] * tpa[axis][1] / 100;
+            dynD8[axis] = (uint32_t) cfg.D8[axis] * prop1 * tpa[axis][2] / 10000;
         }
-        dynP8[axis] = (uint16_t) cfg.P8[axis] * prop1 / 100;
-        dynD8[axis] = (uint16_t) cfg.D8[axis] * prop1 / 100;
         if (rcData[axis] < cfg.midrc)
             rcCommand[axis] = -rcCommand[axis];
     }
@@ -151,6 +159,13 @@ void annexCode(void)
             for (i = 0; i < 8; i++)
                 vbatRaw += vbatRawArray[i];
             vbat = batteryAdcToVoltage(vbatRaw / 8);
+            if (feature(FEATURE_VBAT_COMP)) {
+                // the 8 sample sum converts to 8 * vbat, so the ratio keeps 12.5mV resolution
+                uint32_t sag = batteryAdcToVoltage(vbatRaw);
+                uint32_t nominal = 8 * batteryCellCount * cfg.vbatcompcellvoltage;
+                if (sag)
+                    vbatCompensation = constrain(nominal * 1024 / sag, 1024, 1024 * cfg.vbatcompmax / 100);
+            }
         }
         if ((vbat > batteryWarningVoltage) || (vbat < cfg.vbatmincellvoltage)) { // VBAT ok, buzzer off
             buzzerFreq = 0;
@@ -158,6 +173,12 @@ void annexCode(void)
             buzzerFreq = 4;     // low battery
     }
 
+    if (feature(FEATURE_POWERMETER) && cfg.power_adc_channel) {
+        powerMeterUpdate();
+        if (cfg.batterycapacity && mAhDrawn >= (uint32_t)cfg.batterycapacity * BATTERY_CAPACITY_WARN / 100)
+            buzzerFreq = 4;     // capacity used up, even if voltage still looks ok
+    }
+
     buzzer(buzzerFreq);         // external buzzer routine that handles buzzer events globally now
 
     if ((calibratingA > 0 && sensors(SENSOR_ACC)) || (calibratingG > 0)) {      // Calibration phasis
@@ -223,13 +244,18 @@ uint16_t pwmReadRawRC(uint8_t chan)
 
 void computeRC(void)
 {
-    static int16_t rcData4Values[8][4], rcDataMean[8];
+    static int16_t rcData4Values[RC_CHANS][4], rcDataMean[RC_CHANS];
     static uint8_t rc4ValuesIndex = 0;
     uint8_t chan, a;
+    uint16_t raw;
 
     rc4ValuesIndex++;
-    for (chan = 0; chan < 8; chan++) {
-        rcData4Values[chan][rc4ValuesIndex % 4] = rcReadRawFunc(chan);
+    for (chan = 0; chan < RC_CHANS; chan++) {
+        raw = rcReadRawFunc(chan);
+        // out of range values are dropped, the channel keeps its last value
+        if (!failsafeCheckChannel(chan, raw))
+            raw = rcData[chan];
+        rcData4Values[chan][rc4ValuesIndex % 4] = raw;
         rcDataMean[chan] = 0;
         for (a = 0; a < 4; a++)
             rcDataMean[chan] += rcData4Values[chan][a];
@@ -242,58 +268,111 @@ void computeRC(void)
     }
 }
 
-void loop(void)
+static int16_t errorGyroI[3] = { 0, 0, 0 };
+static int16_t errorAngleI[2] = { 0, 0 };
+
+void pidResetIntegrals(void)
 {
-    static uint8_t rcDelayCommand;      // this indicates the number of time (multiple of RC measurement at 50Hz) the sticks must be maintained to run or switch off motors
-    uint8_t axis, i;
+    errorGyroI[ROLL] = 0;
+    errorGyroI[PITCH] = 0;
+    errorGyroI[YAW] = 0;
+    errorAngleI[ROLL] = 0;
+    errorAngleI[PITCH] = 0;
+    pidFloatReset();
+}
+
+// MultiWii integer PID, cfg.pid_controller = 0
+static void pidMultiWii(void)
+{
+    uint8_t axis;
     int16_t error, errorAngle;
     int16_t delta, deltaSum;
-    int16_t PTerm, ITerm, PTermACC, ITermACC = 0, PTermGYRO = 0, ITermGYRO = 0, DTerm;
+    int16_t PTerm, ITerm, PTermACC = 0, ITermACC = 0, PTermGYRO = 0, ITermGYRO = 0, DTerm;
     static int16_t lastGyro[3] = { 0, 0, 0 };
     static int16_t delta1[3], delta2[3];
-    static int16_t errorGyroI[3] = { 0, 0, 0 };
-    static int16_t errorAngleI[2] = { 0, 0 };
+    int16_t prop;
+
+    prop = max(abs(rcCommand[PITCH]), abs(rcCommand[ROLL])); // range [0;500]
+    for (axis = 0; axis < 3; axis++) {
+        if ((f.ANGLE_MODE || f.HORIZON_MODE) && axis < 2) { // MODE relying on ACC
+            // 50 degrees max inclination
+            errorAngle = constrain(2 * rcCommand[axis] + GPS_angle[axis], -500, +500) - angle[axis] + cfg.angleTrim[axis];
+#ifdef LEVEL_PDF
+            PTermACC = -(int32_t)angle[axis] * dynLevelP8[axis] / 100;
+#else
+            PTermACC = (int32_t)errorAngle * dynLevelP8[axis] / 100; // 32 bits is needed for calculation: errorAngle*P8[PIDLEVEL] could exceed 32768   16 bits is ok for result
+#endif
+            PTermACC = constrain(PTermACC, -cfg.D8[PIDLEVEL] * 5, +cfg.D8[PIDLEVEL] * 5);
+
+            errorAngleI[axis] = constrain(errorAngleI[axis] + errorAngle, -10000, +10000); // WindUp
+            ITermACC = ((int32_t)errorAngleI[axis] * dynLevelI8[axis]) >> 12;
+        }
+        if (!f.ANGLE_MODE || axis == 2) { // MODE relying on GYRO or YAW axis
+            error = (int32_t)rcCommand[axis] * 10 * 8 / cfg.P8[axis];
+            error -= gyroData[axis];
+
+            PTermGYRO = rcCommand[axis];
+
+            errorGyroI[axis] = constrain(errorGyroI[axis] + error, -16000, +16000); // WindUp
+            if (abs(gyroData[axis]) > 640) 
+                errorGyroI[axis] = 0;
+            ITermGYRO = (errorGyroI[axis] / 125 * dynI8[axis]) >> 6;
+        }
+        if (f.HORIZON_MODE && axis < 2) {
+            PTerm = ((int32_t)PTermACC * (500 - prop) + (int32_t)PTermGYRO * prop) / 500;
+            ITerm = ((int32_t)ITermACC * (500 - prop) + (int32_t)ITermGYRO * prop) / 500;
+        } else {
+            if (f.ANGLE_MODE && axis < 2) {
+                PTerm = PTermACC;
+                ITerm = ITermACC;
+            } else {
+                PTerm = PTermGYRO;
+                ITerm = ITermGYRO;
+            }
+        }
+
+        PTerm -= (int32_t)gyroData[axis] * dynP8[axis] / 10 / 8; // 32 bits is needed for calculation
+
+        delta = gyroData[axis] - lastGyro[axis]; // 16 bits is ok here, the dif between 2 consecutive gyro reads is limited to 800
+        lastGyro[axis] = gyroData[axis];
+        deltaSum = delta1[axis] + delta2[axis] + delta;
+        delta2[axis] = delta1[axis];
+        delta1[axis] = delta;
+
+        DTerm = ((int32_t)deltaSum * dynD8[axis]) >> 5; // 32 bits is needed for calculation
+        axisPID[axis] =  PTerm + ITerm - DTerm;
+    }
+}
+
+void loop(void)
+{
+    static uint8_t rcDelayCommand;      // this indicates the number of time (multiple of RC measurement at 50Hz) the sticks must be maintained to run or switch off motors
+    uint8_t i;
     static uint32_t rcTime = 0;
     static int16_t initialThrottleHold;
     static uint32_t loopTime;
-    uint16_t auxState = 0;
-    int16_t prop;
+    boxmask_t auxState = 0;
 
-    // this will return false if spektrum is disabled. shrug.
-    if (spektrumFrameComplete())
+    // GPS/Spektrum parsers run here on whatever USART2 received since the last loop
+    uart2Poll();
+    if (feature(FEATURE_PPM))
+        pwmDecodePPM();
+
+    // these will return false if spektrum/sbus/serial RX is disabled. shrug.
+    if (spektrumFrameComplete() || sbusFrameComplete() || mspFrameComplete())
         computeRC();
 
     if ((int32_t)(currentTime - rcTime) >= 0) { // 50Hz
         rcTime = currentTime + 20000;
         // TODO clean this up. computeRC should handle this check
-        if (!feature(FEATURE_SPEKTRUM))
+        if (!feature(FEATURE_SPEKTRUM) && !feature(FEATURE_SBUS) && !feature(FEATURE_RX_MSP))
             computeRC();
 
-        // Failsafe routine
-        if (feature(FEATURE_FAILSAFE)) {
-            if (failsafeCnt > (5 * cfg.failsafe_delay) && f.ARMED) { // Stabilize, and set Throttle to specified level
-                for (i = 0; i < 3; i++)
-                    rcData[i] = cfg.midrc;      // after specified guard time after RC signal is lost (in 0.1sec)
-                rcData[THROTTLE] = cfg.failsafe_throttle;
-                if (failsafeCnt > 5 * (cfg.failsafe_delay + cfg.failsafe_off_delay)) {  // Turn OFF motors after specified Time (in 0.1sec)
-                    f.ARMED = 0;  // This will prevent the copter to automatically rearm if failsafe shuts it down and prevents
-                    f.OK_TO_ARM = 0;        // to restart accidentely by just reconnect to the tx - you will have to switch off first to rearm
-                }
-                failsafeEvents++;
-            }
-            if (failsafeCnt > (5 * cfg.failsafe_delay) && !f.ARMED) {  // Turn off "Ok To arm to prevent the motors from spinning after repowering the RX with low throttle and aux to arm
-                f.ARMED = 0;        // This will prevent the copter to automatically rearm if failsafe shuts it down and prevents
-                f.OK_TO_ARM = 0;    // to restart accidentely by just reconnect to the tx - you will have to switch off first to rearm
-            }
-            failsafeCnt++;
-        }
+        // Failsafe routine, link statistics and stages
+        failsafeUpdate();
 
         if (rcData[THROTTLE] < cfg.mincheck) {
-            errorGyroI[ROLL] = 0;
-            errorGyroI[PITCH] = 0;
-            errorGyroI[YAW] = 0;
-            errorAngleI[ROLL] = 0;
-            errorAngleI[PITCH] = 0;
+            pidResetIntegrals();
             rcDelayCommand++;
             if (rcData[YAW] < cfg.mincheck && rcData[PITCH] < cfg.mincheck && !f.ARMED) {
                 if (rcDelayCommand == 20) {
@@ -389,13 +468,13 @@ void loop(void)
             }
         }
 
-        for (i = 0; i < 4; i++)
-            auxState |= (rcData[AUX1 + i] < 1300) << (3 * i) | (1300 < rcData[AUX1 + i] && rcData[AUX1 + i] < 1700) << (3 * i + 1) | (rcData[AUX1 + i] > 1700) << (3 * i + 2);
+        for (i = 0; i < AUX_CHANS; i++)
+            auxState |= (boxmask_t)((rcData[AUX1 + i] < 1300) | (1300 < rcData[AUX1 + i] && rcData[AUX1 + i] < 1700) << 1 | (rcData[AUX1 + i] > 1700) << 2) << (3 * i);
         for (i = 0; i < CHECKBOXITEMS; i++)
             rcOptions[i] = (auxState & cfg.activate[i]) > 0;
+        failsafeApplyModes();
 
-        // note: if FAILSAFE is disable, failsafeCnt > 5*FAILSAVE_DELAY is always false
-        if ((rcOptions[BOXANGLE] || (failsafeCnt > 5 * cfg.failsafe_delay)) && (sensors(SENSOR_ACC))) {
+        if (rcOptions[BOXANGLE] && sensors(SENSOR_ACC)) {
             // bumpless transfer to Level mode
             if (!f.ANGLE_MODE) {
                 errorAngleI[ROLL] = 0;
@@ -497,7 +576,7 @@ void loop(void)
         }
     } else {                    // not in rc loop
         static int8_t taskOrder = 0;    // never call all function in the same loop, to avoid high delay spikes
-        switch (taskOrder++ % 4) {
+        switch (taskOrder++ % 3) {
         case 0:
 #ifdef MAG
             if (sensors(SENSOR_MAG))
@@ -505,18 +584,12 @@ void loop(void)
 #endif
             break;
         case 1:
-#ifdef BARO
-            if (sensors(SENSOR_BARO))
-                Baro_update();
-#endif
-            break;
-        case 2:
 #ifdef BARO
             if (sensors(SENSOR_BARO))
                 getEstimatedAltitude();
 #endif
             break;
-        case 3:
+        case 2:
 #ifdef SONAR
             if (sensors(SENSOR_SONAR)) {
                 Sonar_update();
@@ -530,6 +603,12 @@ void loop(void)
         }
     }
 
+#ifdef BARO
+    // not part of taskOrder, Baro_update() keeps its own conversion schedule and returns early when nothing is due
+    if (sensors(SENSOR_BARO))
+        Baro_update();
+#endif
+
     currentTime = micros();
     if (cfg.looptime == 0 || (int32_t)(currentTime - loopTime) >= 0) {
         loopTime = currentTime + cfg.looptime;
@@ -589,57 +668,12 @@ void loop(void)
             }
         }
 
-        // **** PITCH & ROLL & YAW PID ****    
-        prop = max(abs(rcCommand[PITCH]), abs(rcCommand[ROLL])); // range [0;500]
-        for (axis = 0; axis < 3; axis++) {
-            if ((f.ANGLE_MODE || f.HORIZON_MODE) && axis < 2) { // MODE relying on ACC
-                // 50 degrees max inclination
-                errorAngle = constrain(2 * rcCommand[axis] + GPS_angle[axis], -500, +500) - angle[axis] + cfg.angleTrim[axis];
-#ifdef LEVEL_PDF
-                PTermACC = -(int32_t)angle[axis] * cfg.P8[PIDLEVEL] / 100;
-#else
-                PTermACC = (int32_t)errorAngle * cfg.P8[PIDLEVEL] / 100; // 32 bits is needed for calculation: errorAngle*P8[PIDLEVEL] could exceed 32768   16 bits is ok for result
-#endif
-                PTermACC = constrain(PTermACC, -cfg.D8[PIDLEVEL] * 5, +cfg.D8[PIDLEVEL] * 5);
-
-                errorAngleI[axis] = constrain(errorAngleI[axis] + errorAngle, -10000, +10000); // WindUp
-                ITermACC = ((int32_t)errorAngleI[axis] * cfg.I8[PIDLEVEL]) >> 12;
-            }
-            if (!f.ANGLE_MODE || axis == 2) { // MODE relying on GYRO or YAW axis
-                error = (int32_t)rcCommand[axis] * 10 * 8 / cfg.P8[axis];
-                error -= gyroData[axis];
-
-                PTermGYRO = rcCommand[axis];
-
-                errorGyroI[axis] = constrain(errorGyroI[axis] + error, -16000, +16000); // WindUp
-                if (abs(gyroData[axis]) > 640) 
-                    errorGyroI[axis] = 0;
-                ITermGYRO = (errorGyroI[axis] / 125 * cfg.I8[axis]) >> 6;
-            }
-            if (f.HORIZON_MODE && axis < 2) {
-                PTerm = ((int32_t)PTermACC * (500 - prop) + (int32_t)PTermGYRO * prop) / 500;
-                ITerm = ((int32_t)ITermACC * (500 - prop) + (int32_t)ITermGYRO * prop) / 500;
-            } else {
-                if (f.ANGLE_MODE && axis < 2) {
-                    PTerm = PTermACC;
-                    ITerm = ITermACC;
-                } else {
-                    PTerm = PTermGYRO;
-                    ITerm = ITermGYRO;
-                }
-            }
-
-            PTerm -= (int32_t)gyroData[axis] * dynP8[axis] / 10 / 8; // 32 bits is needed for calculation
-
-            delta = gyroData[axis] - lastGyro[axis]; // 16 bits is ok here, the dif between 2 consecutive gyro reads is limited to 800
-            lastGyro[axis] = gyroData[axis];
-            deltaSum = delta1[axis] + delta2[axis] + delta;
-            delta2[axis] = delta1[axis];
-            delta1[axis] = delta;
-
-            DTerm = ((int32_t)deltaSum * dynD8[axis]) >> 5; // 32 bits is needed for calculation
-            axisPID[axis] =  PTerm + ITerm - DTerm;
-        }
+        // **** PITCH & ROLL & YAW PID ****
+        if (cfg.pid_controller == 1)
+            pidFloat();
+        else
+            pidMultiWii();
+        autotuneUpdate();
 
         mixTable();
         writeServos();
@@ -2,6 +2,7 @@
 
 /* for VBAT monitoring frequency */
 #define VBATFREQ 6        // to read battery voltage - nth number of loop iterations
+#define BATTERY_CAPACITY_WARN 80    // percent of batterycapacity drawn before the low battery buzzer
 #define BARO_TAB_SIZE_MAX   48
 
 #define  VERSION  211
@@ -34,7 +35,7 @@ typedef enum MultiType
     MULTITYPE_OCTOX8 = 11,          // Java GUI is same for the next 3 configs
     MULTITYPE_OCTOFLATP = 12,       // MultiWinGui shows this differently
     MULTITYPE_OCTOFLATX = 13,       // MultiWinGui shows this differently
-    MULTITYPE_AIRPLANE = 14,        // airplane / singlecopter / dualcopter (not yet properly supported)
+    MULTITYPE_AIRPLANE = 14,        // airplane / singlecopter / dualcopter
     MULTITYPE_HELI_120_CCPM = 15,
     MULTITYPE_HELI_90_DEG = 16,
     MULTITYPE_VTAIL4 = 17,
@@ -61,6 +62,22 @@ enum {
     AUX4
 };
 
+// Channels handled by the RC pipeline, sticks + AUX. Builds for 12-18 channel receivers set more, e.g.
+// OPTIONS=RC_CHANS=16. AUX switch positions are 3 bits each in the box masks, which grow with the AUX count
+#ifndef RC_CHANS
+#define RC_CHANS    8
+#endif
+#define AUX_CHANS   (RC_CHANS - 4)      // everything after ROLL, PITCH, YAW, THROTTLE
+#if AUX_CHANS > 21
+#error "RC_CHANS too large for the box mask"
+#elif AUX_CHANS > 10
+typedef uint64_t boxmask_t;
+#elif AUX_CHANS > 5
+typedef uint32_t boxmask_t;
+#else
+typedef uint16_t boxmask_t;
+#endif
+
 enum {
     PIDROLL,
     PIDPITCH,
@@ -91,6 +108,7 @@ enum {
     BOXLEDMAX,
     BOXLLIGHTS,
     BOXHEADADJ,
+    BOXAUTOTUNE,
     CHECKBOXITEMS
 };
 
@@ -140,6 +158,15 @@ typedef struct config_t {
     uint8_t yawRate;
 
     uint8_t dynThrPID;
+    uint16_t tpa_breakpoint;                // throttle where PID attenuation starts, dynThrPID and the tpa curves run from here to 2000
+    int8_t tpa_p[3][5];                     // ROLL/PITCH/YAW P in percent at 0/25/50/75/100% of tpa_breakpoint..2000, ROLL+PITCH also get dynThrPID
+    int8_t tpa_i[3][5];                     // same for I, the level loop uses the ROLL/PITCH P/I curves without dynThrPID
+    int8_t tpa_d[3][5];                     // same for D
+    uint8_t pid_controller;                 // 0 = MultiWii integer PID, 1 = floating point rate PID in deg/s
+    uint16_t pid_max_rate;                  // pid_controller 1: rotation rate at full stick in deg/s
+    uint16_t pid_output_limit;              // pid_controller 1: axisPID limit, the integrator is wound back beyond it
+    uint8_t autotune_relay;                 // axisPID step used by the relay autotune
+    uint8_t autotune_rule;                  // 0 = Ziegler-Nichols, 1 = some overshoot, 2 = no overshoot
     int16_t accZero[3];
     int16_t magZero[3];
     int16_t mag_declination;                // Get your magnetic decliniation from here : http://magnetic-declination.com/
@@ -154,20 +181,28 @@ typedef struct config_t {
     uint16_t gyro_lpf;                      // mpuX050 LPF setting (TODO make it work on L3GD as well)
     uint16_t gyro_cmpf_factor;              // Set the Gyro Weight for Gyro/Acc complementary filter. Increasing this value would reduce and delay Acc influence on the output of the filter.
     uint32_t gyro_smoothing_factor;         // How much to smoothen with per axis (32bit value with Roll, Pitch, Yaw in bits 24, 16, 8 respectively
+    uint16_t i2c_speed;                     // I2C bus clock in kHz. 400 is the spec maximum, 800/1000 overclock the bus for sensors that tolerate it
     uint8_t mpu6050_scale;                  // seems es/non-es variance between MPU6050 sensors, half my boards are mpu6000ES, need this to be dynamic. fucking invenshit won't release chip IDs so I can't autodetect it.
     uint8_t baro_tab_size;                  // size of baro filter array
     float baro_noise_lpf;                   // additional LPF to reduce baro noise
     float baro_cf;                          // apply Complimentary Filter to keep the calculated velocity based on baro velocity (i.e. near real velocity)
+    uint8_t baro_temp_interval;             // number of pressure conversions per temperature conversion
+    uint8_t ms5611_osr;                     // MS5611 oversampling, 0..4 = OSR 256..4096. Lower is faster but noisier
     uint8_t moron_threshold;                // people keep forgetting that moving model while init results in wrong gyro offsets. and then they never reset gyro. so this is now on by default.
 
-    uint16_t activate[CHECKBOXITEMS];       // activate switches
+    boxmask_t activate[CHECKBOXITEMS];      // activate switches, low/mid/high bit per AUX channel
     uint8_t vbatscale;                      // adjust this to match battery voltage to reported value
     uint8_t vbatmaxcellvoltage;             // maximum voltage per cell, used for auto-detecting battery voltage in 0.1V units, default is 43 (4.3V)
     uint8_t vbatmincellvoltage;             // minimum voltage per cell, this triggers battery out alarms, in 0.1V units, default is 33 (3.3V)
+    uint8_t vbatcompcellvoltage;            // FEATURE_VBAT_COMP: cell voltage the PID was tuned at, in 0.1V units. No compensation above it
+    uint8_t vbatcompmax;                    // FEATURE_VBAT_COMP: maximum mixer gain in percent as the pack sags
     uint8_t power_adc_channel;              // which channel is used for current sensor. Right now, only 2 places are supported: RC_CH2 (unused when in CPPM mode, = 1), RC_CH8 (last channel in PWM mode, = 9)
+    uint16_t currentscale;                  // current sensor output in 0.1mV per amp, default is 400 (40mV/A)
+    uint16_t currentoffset;                 // current sensor output in mV at 0A
+    uint16_t batterycapacity;               // mAh, warn when BATTERY_CAPACITY_WARN percent of it is used. 0 = off
 
     // Radio/ESC-related configuration
-    uint8_t rcmap[8];                       // mapping of radio channels to internal RPYTA+ order
+    uint8_t rcmap[RC_CHANS];                // mapping of radio channels to internal RPYTA+ order. "map" sets the first 8, the rest stay 1:1
     uint8_t deadband;                       // introduce a deadband around the stick center for pitch and roll axis. Must be greater than zero.
     uint8_t yawdeadband;                    // introduce a deadband around the stick center for yaw axis. Must be greater than zero.
     uint8_t alt_hold_throttle_neutral;      // defines the neutral zone of throttle stick during altitude hold, default setting is +/-20
@@ -181,6 +216,7 @@ typedef struct config_t {
     uint8_t failsafe_delay;                 // Guard time for failsafe activation after signal lost. 1 step = 0.1sec - 1sec in example (10)
     uint8_t failsafe_off_delay;             // Time for Landing before motors stop in 0.1sec. 1 step = 0.1sec - 20sec in example (200)
     uint16_t failsafe_throttle;             // Throttle level used for landing - specify value between 1000..2000 (pwm pulse width for slightly below hover). center throttle = 1500.
+    uint16_t rx_msp_timeout;                // ms without MSP_SET_RAW_RC before serial RX goes straight to failsafe
 
     // motor/esc/servo related stuff
     uint16_t minthrottle;                   // Set the minimum throttle command sent to the ESC (Electronic Speed Controller). This is the minimum value that allow motors to run at a idle speed.
@@ -188,11 +224,17 @@ typedef struct config_t {
     uint16_t mincommand;                    // This is the value for the ESCs when they are not armed. In some cases, this value must be lowered down to 900 for some specific ESCs
     uint16_t motor_pwm_rate;                // The update rate of motor outputs (50-498Hz)
     uint16_t servo_pwm_rate;                // The update rate of servo outputs (50-498Hz)
+    uint16_t dshot_rate;                    // DShot bit rate in kbit/s when FEATURE_DSHOT is enabled, 150 or 300
+    uint8_t thrust_linear;                  // quadratic share of the motor thrust curve in percent, compensated after mixing. 0 = off
     int16_t servotrim[8];                   // Adjust Servo MID Offset & Swash angles
     int8_t servoreverse[8];                 // Invert servos by setting -1
+    uint16_t servoendpoint_low[8];          // Servo travel limits, applied after trim and reverse
+    uint16_t servoendpoint_high[8];
+    uint8_t servorate[8];                   // Max servo movement per servo frame in us, 0 = no limit
 
     // mixer-related configuration
     int8_t yaw_direction;
+    uint8_t mixer_airmode;                  // 1 = raise all motors above minthrottle when the PID mix dips below it, keeps authority at zero throttle
     uint16_t tri_yaw_middle;                // tail servo center pos. - use this for initial trim
     uint16_t tri_yaw_min;                   // tail servo min
     uint16_t tri_yaw_max;                   // tail servo max
@@ -209,6 +251,18 @@ typedef struct config_t {
     int8_t roll_direction_l;                // left servo - roll orientation
     int8_t roll_direction_r;                // right servo - roll orientation  (same sign as ROLL_DIRECTION_L, if servos are mounted in mirrored orientation)
 
+    // airplane related configuration
+    uint8_t flaps;                          // AUX channel (1-based) driving the flaps servo, 0 = none
+    uint8_t flaperons;                      // AUX channel (1-based) drooping both ailerons, 0 = none
+    uint8_t flapspeed;                      // max flap/flaperon movement per loop in us, 0 = no limit
+
+    // helicopter related configuration
+    int16_t heli_swash_phase;               // 120 CCPM swash rotation in degrees, 0 = servos left/right/rear
+    uint16_t heli_collective_throw;         // swash servo travel in us at +-100% collective
+    int8_t heli_pitch_curve[5];             // collective in percent at 0/25/50/75/100% throttle stick
+    int8_t heli_throttle_curve[5];          // throttle in percent of minthrottle..maxthrottle at the same stick points
+    int8_t heli_tail_revomix;               // percent of collective mixed into the tail servo
+
     // gimbal-related configuration
     int8_t gimbal_pitch_gain;               // gimbal pitch servo gain (tied to angle) can be negative to invert movement
     int8_t gimbal_roll_gain;                // gimbal roll servo gain (tied to angle) can be negative to invert movement
@@ -260,9 +314,50 @@ extern int16_t gyroZero[3];
 extern int16_t gyroData[3];
 extern int16_t angle[2];
 extern int16_t axisPID[3];
+extern uint8_t dynP8[3], dynI8[3], dynD8[3];
+extern uint8_t dynLevelP8[2], dynLevelI8[2];
 extern int16_t rcCommand[4];
 extern uint8_t rcOptions[CHECKBOXITEMS];
 extern int16_t failsafeCnt;
+extern int16_t failsafeEvents;
+
+typedef enum {
+    FAILSAFE_IDLE = 0,
+    FAILSAFE_HOLD,              // link lost, last values held for failsafe_delay
+    FAILSAFE_RTH,               // level, GPS home with baro alt hold
+    FAILSAFE_LANDING,           // level, failsafe_throttle for failsafe_off_delay
+    FAILSAFE_DISARMED,          // motors turned off by failsafe
+} failsafeStage_e;
+
+typedef struct failsafe_t {
+    uint8_t stage;
+    uint16_t stageTicks;        // failsafeUpdate() calls in this stage
+    uint16_t frameRate;         // valid frames in the last second
+    uint16_t glitches;          // bad frames and channels going out of range
+    uint32_t channelValid;      // bit per RC channel, in range on the last read
+} failsafe_t;
+
+extern failsafe_t failsafe;
+
+typedef enum {
+    AUTOTUNE_IDLE = 0,
+    AUTOTUNE_RUNNING,           // relay on autotune.axis
+    AUTOTUNE_FAILED,            // tilted too far or no oscillation, switch the box off to reset
+} autotuneState_e;
+
+typedef struct autotune_t {
+    uint8_t state;
+    uint8_t axis;               // ROLL or PITCH while running
+    uint8_t ready;              // box was off, the next switch on starts a run
+    uint8_t done;               // bit per axis with candidate gains waiting for "autotune apply"
+    float ku[2];                // ultimate gain, axisPID per gyroData LSB
+    float tu[2];                // ultimate period in s
+    uint8_t P8[2];              // candidate gains
+    uint8_t I8[2];
+    uint8_t D8[2];
+} autotune_t;
+
+extern autotune_t autotune;
 
 extern int16_t debug[4];
 extern int16_t gyroADC[3], accADC[3], accSmooth[3], magADC[3];
@@ -275,7 +370,9 @@ extern uint16_t calibratingG;
 extern int16_t heading;
 extern int16_t annex650_overrun_count;
 extern int32_t BaroAlt;
+extern uint32_t BaroTime;
 extern int16_t sonarAlt;
+extern bool sonarValid;
 extern int32_t EstAlt;
 extern int32_t AltHold;
 extern int16_t errorAltitudeI;
@@ -285,11 +382,16 @@ extern int16_t zVelocity;
 extern int16_t heading, magHold;
 extern int16_t motor[MAX_MOTORS];
 extern int16_t servo[8];
-extern int16_t rcData[8];
+extern int16_t rcData[RC_CHANS];
 extern uint8_t vbat;
+extern uint16_t vbatCompensation;
+extern int16_t amperage;
+extern uint32_t mAhDrawn;
 extern int16_t telemTemperature1;      // gyro sensor temperature
 extern int16_t lookupPitchRollRC[6];   // lookup table for expo & RC rate PITCH+ROLL
 extern int16_t lookupThrottleRC[11];   // lookup table for expo & mid THROTTLE
+extern uint8_t lookupThrottlePID[3][3][11];
+extern uint8_t lookupThrottleDyn[11];
 extern uint8_t toggleBeep;
 
 // GPS stuff
@@ -329,6 +431,7 @@ void getEstimatedAltitude(void);
 void sensorsAutodetect(void);
 void batteryInit(void);
 uint16_t batteryAdcToVoltage(uint16_t src);
+void powerMeterUpdate(void);
 void ACC_getADC(void);
 void Baro_update(void);
 void Gyro_getADC(void);
@@ -367,6 +470,33 @@ uint32_t featureMask(void);
 // spektrum
 void spektrumInit(void);
 bool spektrumFrameComplete(void);
+uint32_t spektrumGetFrameTime(void);
+uint32_t spektrumGetFrameInterval(void);
+
+// serial rx
+bool mspFrameComplete(void);
+
+// pid
+void pidFloat(void);
+void pidFloatReset(void);
+void pidResetIntegrals(void);
+
+// autotune
+void autotuneComputeGains(float ku, float tu, float dt, uint8_t rule, uint8_t *p, uint8_t *i, uint8_t *d);
+void autotuneUpdate(void);
+bool autotuneApply(void);
+
+// failsafe
+void failsafeOnValidFrame(void);
+void failsafeOnGlitch(void);
+void failsafeOnRxFailsafe(void);
+bool failsafeCheckChannel(uint8_t chan, uint16_t value);
+void failsafeUpdate(void);
+void failsafeApplyModes(void);
+
+// sbus
+void sbusInit(void);
+bool sbusFrameComplete(void);
 
 // buzzer
 void buzzer(uint8_t warn_vbat);
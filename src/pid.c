@@ -0,0 +1,84 @@
+#include "board.h"
+#include "mw.h"
+
+// Floating point rate controller, cfg.pid_controller = 1.
+// Works in deg/s on gyroData, integrates and differentiates over the measured cycleTime, and keeps the output
+// within pid_output_limit. The integrator is wound back by the amount the output got clipped (back-calculation),
+// so it never builds up while saturated. Gains come from P8/I8/D8, scaled so a tune made for the MultiWii
+// controller at 3.5ms looptime gives about the same response.
+// Angle and horizon modes wrap a P-only level loop around it that asks for a rate.
+// All gains are the throttle attenuated dynP8/dynI8/dynD8/dynLevelP8 from annexCode().
+
+#define GYRO_DPS        (1998.0f / (32767.0f / 4.0f))   // deg/s per gyroData LSB, see GYRO_SCALE in imu.c
+#define REF_DT          0.0035f                         // s, looptime the MultiWii gains are tuned for
+
+static float iTerm[3];
+static float gyroHistory[3][3];     // deg/s, last 3 samples for the derivative
+static float dtHistory[3];
+static uint8_t historyIndex = 0;
+
+void pidFloatReset(void)
+{
+    iTerm[ROLL] = 0.0f;
+    iTerm[PITCH] = 0.0f;
+    iTerm[YAW] = 0.0f;
+}
+
+void pidFloat(void)
+{
+    uint8_t axis;
+    float dt, dtSum, setpoint, levelSetpoint, gyroRate, error;
+    float kp, ki, kd, pTerm, dTerm, output, limited;
+    float maxRate = cfg.pid_max_rate;
+    int16_t prop, errorAngle;
+
+    dt = cycleTime * 1e-6f;
+    if (dt <= 0.0f)
+        return;
+    dtHistory[historyIndex] = dt;
+    dtSum = dtHistory[0] + dtHistory[1] + dtHistory[2];
+
+    prop = max(abs(rcCommand[PITCH]), abs(rcCommand[ROLL])); // range [0;500]
+    for (axis = 0; axis < 3; axis++) {
+        // stick rate, full deflection (500) is pid_max_rate
+        setpoint = rcCommand[axis] * maxRate / 500.0f;
+
+        if ((f.ANGLE_MODE || f.HORIZON_MODE) && axis < 2) {
+            // 50 degrees max inclination, error in 0.1deg, P8[PIDLEVEL] / 10 is deg/s per deg
+            errorAngle = constrain(2 * rcCommand[axis] + GPS_angle[axis], -500, +500) - angle[axis] + cfg.angleTrim[axis];
+            levelSetpoint = constrain(errorAngle * dynLevelP8[axis] / 100.0f, -maxRate, maxRate);
+            if (f.HORIZON_MODE)
+                setpoint = (levelSetpoint * (500 - prop) + setpoint * prop) / 500.0f;
+            else
+                setpoint = levelSetpoint;
+        }
+
+        gyroRate = gyroData[axis] * GYRO_DPS;
+        error = setpoint - gyroRate;
+
+        kp = dynP8[axis] / 80.0f / GYRO_DPS;
+        ki = dynI8[axis] / 8000.0f / GYRO_DPS / REF_DT;
+        kd = dynD8[axis] / 32.0f * 3 * REF_DT / GYRO_DPS;
+
+        pTerm = kp * error;
+
+        // derivative on measurement over the last 3 samples, so setpoint steps don't kick
+        dTerm = 0.0f;
+        if (dtSum > 0.0f)
+            dTerm = -kd * (gyroRate - gyroHistory[axis][historyIndex]) / dtSum;
+        gyroHistory[axis][historyIndex] = gyroRate;
+
+        output = pTerm + iTerm[axis] + dTerm;
+        limited = constrain(output, -cfg.pid_output_limit, cfg.pid_output_limit);
+
+        // back-calculation anti-windup, tracking time constant Ti = kp / ki
+        iTerm[axis] += ki * error * dt;
+        if (kp > 0.0f)
+            iTerm[axis] += (limited - output) * ki / kp * dt;
+        iTerm[axis] = constrain(iTerm[axis], -cfg.pid_output_limit, cfg.pid_output_limit);
+
+        axisPID[axis] = limited + (limited < 0.0f ? -0.5f : 0.5f);
+    }
+
+    historyIndex = (historyIndex + 1) % 3;
+}
@@ -0,0 +1,108 @@
+#include "board.h"
+#include "mw.h"
+
+// driver for futaba sbus receiver using UART2 (freeing up more motor outputs for stuff)
+// sbus is an inverted signal, RX needs an external inverter (the F1 usart can't invert)
+
+#define SBUS_BAUDRATE           100000
+#define SBUS_FRAME_SIZE         25
+#define SBUS_FRAME_BEGIN_BYTE   0x0F
+#define SBUS_FLAGS_BYTE         23
+#define SBUS_FLAG_FRAME_LOST    (1 << 2)
+#define SBUS_FLAG_FAILSAFE      (1 << 3)
+#define SBUS_MAX_CHANNEL        16
+
+static bool rcFrameComplete = false;
+static bool sbusDataIncoming = false;
+static uint8_t sbusFrame[SBUS_FRAME_SIZE];
+static uint16_t sbusChannelData[SBUS_MAX_CHANNEL];     // us
+uint16_t sbusFramesLost = 0;                            // frames the receiver flagged as lost
+static void sbusDataReceive(uint16_t c);
+
+// 16 channels of 11 bits each, packed LSB first starting at byte 1. Where each one starts:
+typedef struct sbusChannelPos_t {
+    uint8_t byte;
+    uint8_t shift;
+} sbusChannelPos_t;
+
+static const sbusChannelPos_t sbusChannelPos[SBUS_MAX_CHANNEL] = {
+    { 1, 0 }, { 2, 3 }, { 3, 6 }, { 5, 1 }, { 6, 4 }, { 7, 7 }, { 9, 2 }, { 10, 5 },
+    { 12, 0 }, { 13, 3 }, { 14, 6 }, { 16, 1 }, { 17, 4 }, { 18, 7 }, { 20, 2 }, { 21, 5 },
+};
+
+void sbusInit(void)
+{
+    uart2SetFormat(USART_StopBits_2, USART_Parity_Even);
+    uart2Init(SBUS_BAUDRATE, sbusDataReceive, true);
+}
+
+static void sbusDecodeFrame(void)
+{
+    uint8_t flags = sbusFrame[SBUS_FLAGS_BYTE];
+    const sbusChannelPos_t *pos;
+    uint32_t raw;
+    uint8_t i;
+
+    if (flags & SBUS_FLAG_FAILSAFE) {
+        // receiver lost the link and sends its own failsafe values. Keep the last good ones and let failsafe take over
+        failsafeOnRxFailsafe();
+        return;
+    }
+
+    if (flags & SBUS_FLAG_FRAME_LOST) {
+        // repeat of old data, don't reset the failsafe counter for it
+        sbusFramesLost++;
+        failsafeOnGlitch();
+        return;
+    }
+
+    for (i = 0; i < SBUS_MAX_CHANNEL; i++) {
+        pos = &sbusChannelPos[i];
+        raw = sbusFrame[pos->byte] | (sbusFrame[pos->byte + 1] << 8) | ((uint32_t)sbusFrame[pos->byte + 2] << 16);
+        // 172..1811 -> 988..2012
+        sbusChannelData[i] = 880 + ((((raw >> pos->shift) & 0x7FF) * 5) >> 3);
+    }
+    sbusDataIncoming = true;
+    rcFrameComplete = true;
+    failsafeOnValidFrame();
+}
+
+// UART2 receive callback, called from main loop by uart2Poll()
+static void sbusDataReceive(uint16_t c)
+{
+    static uint8_t sbusFramePosition = 0;
+
+    // frames are sent back to back, the line goes idle between frames
+    if (c == UART_FRAME_END) {
+        sbusFramePosition = 0;
+        return;
+    }
+
+    // wait for the start of the next frame after garbage
+    if (sbusFramePosition == 0 && c != SBUS_FRAME_BEGIN_BYTE)
+        return;
+    if (sbusFramePosition >= SBUS_FRAME_SIZE)
+        return;
+
+    sbusFrame[sbusFramePosition++] = (uint8_t)c;
+    if (sbusFramePosition == SBUS_FRAME_SIZE)
+        sbusDecodeFrame();
+}
+
+// true once for each decoded frame
+bool sbusFrameComplete(void)
+{
+    if (rcFrameComplete) {
+        rcFrameComplete = false;
+        return true;
+    }
+    return false;
+}
+
+uint16_t sbusReadRawRC(uint8_t chan)
+{
+    if (!sbusDataIncoming || cfg.rcmap[chan] >= SBUS_MAX_CHANNEL)
+        return cfg.midrc;
+
+    return sbusChannelData[cfg.rcmap[chan]];
+}
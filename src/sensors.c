@@ -18,6 +18,7 @@ extern float magneticDeclination;
 sensor_t acc;                       // acc access functions
 sensor_t gyro;                      // gyro access functions
 baro_t baro;                        // barometer access functions
+uint16_t baroConvOverrun = 0;       // conversions that had to be read on timeout because EOC never came
 uint8_t accHardware = ACC_DEFAULT;  // which accel chip is used/detected
 
 #ifdef FY90Q
@@ -88,7 +89,7 @@ retry:
 
 #ifdef BARO
     // Detect what pressure sensors are available. baro->update() is set to sensor-specific update function
-    if (!ms5611Detect(&baro)) {
+    if (!ms5611Detect(&baro, cfg.ms5611_osr)) {
         // ms5611 disables BMP085, and tries to initialize + check PROM crc. if this works, we have a baro
         if (!bmp085Detect(&baro)) {
             // if both failed, we don't have anything
@@ -130,6 +131,29 @@ uint16_t batteryAdcToVoltage(uint16_t src)
     return (((src) * 3.3f) / 4095) * cfg.vbatscale;
 }
 
+// Integrates current into mAhDrawn over micros() so it doesn't depend on loop time.
+void powerMeterUpdate(void)
+{
+    static uint32_t lastTime = 0;
+    static uint32_t remainder = 0;  // 0.01A * us not yet counted as a whole mAh
+    uint32_t now = micros();
+    uint32_t dt = now - lastTime;
+    int32_t millivolts;
+
+    lastTime = now;
+    // 3.3V = ADC Vref, 4095 = 12bit adc
+    millivolts = (int32_t)adcGetChannel(ADC_CURRENT) * 3300 / 4095;
+    amperage = constrain((millivolts - cfg.currentoffset) * 1000 / cfg.currentscale, 0, 32000);
+
+    // skip the first call and anything long enough to overflow
+    if (dt > 100000)
+        return;
+    // 1mAh = 0.1 * 0.01A * 3600s
+    remainder += amperage * dt;
+    mAhDrawn += remainder / 360000000;
+    remainder %= 360000000;
+}
+
 void batteryInit(void)
 {
     uint32_t i;
@@ -269,40 +293,53 @@ void ACC_getADC(void)
 }
 
 #ifdef BARO
+// Called every loop, returns immediately until the running conversion is done. Each result is read out and
+// the next conversion started in the same call so the sensor never sits idle. Temperature changes slowly, so
+// it is only converted once every cfg.baro_temp_interval pressure samples.
+// Sensors with an EOC signal are read as soon as it fires, the conversion delay is then only a timeout.
 void Baro_update(void)
 {
     static uint32_t baroDeadline = 0;
+    static uint32_t convStart = 0;
     static uint8_t state = 0;
+    static uint8_t pressureCount = 0;
     int32_t pressure;
 
-    if ((int32_t)(currentTime - baroDeadline) < 0)
+    if (state != 0 && baro.ready) {
+        if (!baro.ready()) {
+            if ((int32_t)(currentTime - baroDeadline) < 0)
+                return;
+            baroConvOverrun++;
+        }
+    } else if ((int32_t)(currentTime - baroDeadline) < 0)
         return;
 
-    baroDeadline = currentTime;
-
     switch (state) {
-        case 0:
-            baro.start_ut();
-            state++;
-            baroDeadline += baro.ut_delay;
+        case 0: // first call, nothing converted yet
             break;
         case 1:
             baro.get_ut();
-            state++;
             break;
         case 2:
-            baro.start_up();
-            state++;
-            baroDeadline += baro.up_delay;
-            break;
-        case 3:
             baro.get_up();
             pressure = baro.calculate();
             BaroAlt = (1.0f - pow(pressure / 101325.0f, 0.190295f)) * 4433000.0f; // centimeter
-            state = 0;
-            baroDeadline += baro.repeat_delay;
+            BaroTime = convStart + baro.up_delay / 2; // middle of the conversion window
+            pressureCount++;
             break;
     }
+
+    if (state == 0 || pressureCount >= cfg.baro_temp_interval) {
+        pressureCount = 0;
+        baro.start_ut();
+        state = 1;
+        baroDeadline = currentTime + baro.ut_delay;
+    } else {
+        baro.start_up();
+        state = 2;
+        baroDeadline = currentTime + baro.up_delay;
+    }
+    convStart = currentTime;
 }
 #endif /* BARO */
 
@@ -546,16 +583,57 @@ void Mag_getADC(void)
 
 #ifdef SONAR
 
+#define SONAR_MIN_RANGE     2       // cm, HC-SR04 spec is 2cm..4m
+#define SONAR_MAX_RANGE     400
+#define SONAR_MEDIAN_SIZE   5
+#define SONAR_MAX_MISSES    3       // out of range readings in a row before sonarAlt is no longer trusted
+
 void Sonar_init(void) 
 {
     hcsr04_init(sonar_rc78);
     sensorsSet(SENSOR_SONAR);
     sonarAlt = 0;
+    sonarValid = false;
 }
 
 void Sonar_update(void) 
 {
-    hcsr04_get_distance(&sonarAlt);
+    static int16_t samples[SONAR_MEDIAN_SIZE];
+    static uint8_t sampleIdx = 0, sampleCount = 0, misses = 0;
+    int16_t sorted[SONAR_MEDIAN_SIZE];
+    int32_t distance;
+    int16_t tmp;
+    uint8_t i, j;
+
+    hcsr04_start_reading();
+    if (!hcsr04_get_distance(&distance))
+        return;
+
+    if (distance < SONAR_MIN_RANGE || distance > SONAR_MAX_RANGE) {
+        // no echo or too far, drop the history so stale readings don't come back
+        if (++misses >= SONAR_MAX_MISSES) {
+            sonarValid = false;
+            sampleCount = 0;
+            sampleIdx = 0;
+        }
+        return;
+    }
+    misses = 0;
+
+    samples[sampleIdx] = distance;
+    sampleIdx = (sampleIdx + 1) % SONAR_MEDIAN_SIZE;
+    if (sampleCount < SONAR_MEDIAN_SIZE)
+        sampleCount++;
+
+    // median of the last few readings removes single bad echoes
+    for (i = 0; i < sampleCount; i++) {
+        tmp = samples[i];
+        for (j = i; j > 0 && sorted[j - 1] > tmp; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = tmp;
+    }
+    sonarAlt = sorted[sampleCount / 2];
+    sonarValid = sampleCount >= 3;
 }
 
 #endif
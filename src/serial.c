@@ -10,12 +10,12 @@
 #define MSP_RAW_IMU              102    //out message         9 DOF
 #define MSP_SERVO                103    //out message         8 servos
 #define MSP_MOTOR                104    //out message         8 motors
-#define MSP_RC                   105    //out message         8 rc chan
+#define MSP_RC                   105    //out message         RC_CHANS rc chan
 #define MSP_RAW_GPS              106    //out message         fix, numsat, lat, lon, alt, speed
 #define MSP_COMP_GPS             107    //out message         distance home, direction home
 #define MSP_ATTITUDE             108    //out message         2 angles 1 heading
 #define MSP_ALTITUDE             109    //out message         1 altitude
-#define MSP_BAT                  110    //out message         vbat, powermetersum
+#define MSP_BAT                  110    //out message         vbat, mAh drawn, rssi, current
 #define MSP_RC_TUNING            111    //out message         rc rate, rc expo, rollpitch rate, yaw rate, dyn throttle PID
 #define MSP_PID                  112    //out message         up to 16 P I D (8 are used)
 #define MSP_BOX                  113    //out message         up to 16 checkbox (11 are used)
@@ -25,7 +25,7 @@
 #define MSP_PIDNAMES             117    //out message         the PID names
 #define MSP_WP                   118    //out message         get a WP, WP# is in the payload, returns (WP#, lat, lon, alt, flags) WP#0-home, WP#16-poshold
 
-#define MSP_SET_RAW_RC           200    //in message          8 rc chan
+#define MSP_SET_RAW_RC           200    //in message          up to RC_CHANS rc chan
 #define MSP_SET_RAW_GPS          201    //in message          fix, numsat, lat, lon, alt, speed
 #define MSP_SET_PID              202    //in message          up to 16 P I D (8 are used)
 #define MSP_SET_BOX              203    //in message          up to 16 checkbox (11 are used)
@@ -43,6 +43,11 @@
 
 #define MSP_ACC_TRIM             240    //out message         get acc angle trim values
 #define MSP_SET_ACC_TRIM         239    //in message          set acc angle trim values
+#define MSP_I2C_STATS            241    //out message         i2c bus speed, error count, per-device transfer/error/timing stats
+#define MSP_FAILSAFE             242    //out message         failsafe stage, link lost time, frame rate, glitches, valid channels, events
+#define MSP_SET_RAW_RC_SEQ       243    //in message          sequence + up to RC_CHANS rc chan, replies sequence, last applied sequence, its latency
+#define MSP_BOX_EXT              244    //out message         bytes per mask + full width checkbox masks for all AUX_CHANS
+#define MSP_SET_BOX_EXT          245    //in message          checkbox + its mask, any width up to bytes per mask
 
 #define INBUF_SIZE 64
 
@@ -61,7 +66,8 @@ static const char boxnames[] =
     "BEEPER;"
     "LEDMAX;"
     "LLIGHTS;"
-    "HEADADJ;";
+    "HEADADJ;"
+    "AUTOTUNE;";
 
 static const char pidnames[] =
     "ROLL;"
@@ -76,43 +82,33 @@ static const char pidnames[] =
     "VEL;";
 
 static uint8_t checksum, indRX, inBuf[INBUF_SIZE];
-static uint8_t cmdMSP;
+static uint8_t cmdMSP, dataSize;
+// reply is built in place in the uart tx buffer, NULL if there was no room and it gets dropped
+static uint8_t *txFrame;
+static uint16_t txFramePos, txFrameSize;
 static bool guiConnected = false;
 // signal that we're in cli mode
 uint8_t cliMode = 0;
 
-void serialize32(uint32_t a)
+void serialize8(uint8_t a)
 {
-    static uint8_t t;
-    t = a;
-    uartWrite(t);
-    checksum ^= t;
-    t = a >> 8;
-    uartWrite(t);
-    checksum ^= t;
-    t = a >> 16;
-    uartWrite(t);
-    checksum ^= t;
-    t = a >> 24;
-    uartWrite(t);
-    checksum ^= t;
+    if (txFramePos < txFrameSize)
+        txFrame[txFramePos++] = a;
+    checksum ^= a;
 }
 
-void serialize16(int16_t a)
+void serialize32(uint32_t a)
 {
-    static uint8_t t;
-    t = a;
-    uartWrite(t);
-    checksum ^= t;
-    t = a >> 8 & 0xff;
-    uartWrite(t);
-    checksum ^= t;
+    serialize8(a);
+    serialize8(a >> 8);
+    serialize8(a >> 16);
+    serialize8(a >> 24);
 }
 
-void serialize8(uint8_t a)
+void serialize16(int16_t a)
 {
-    uartWrite(a);
-    checksum ^= a;
+    serialize8(a);
+    serialize8(a >> 8 & 0xff);
 }
 
 uint8_t read8(void)
@@ -136,6 +132,13 @@ uint32_t read32(void)
 
 void headSerialResponse(uint8_t err, uint8_t s)
 {
+    // $M> + size + cmd + payload + checksum
+    txFrameSize = s + 6;
+    txFramePos = 0;
+    txFrame = uartTxReserve(txFrameSize);
+    if (!txFrame)
+        txFrameSize = 0;
+
     serialize8('$');
     serialize8('M');
     serialize8(err ? '!' : '>');
@@ -157,6 +160,8 @@ void headSerialError(uint8_t s)
 void tailSerialReply(void)
 {
     serialize8(checksum);
+    uartTxCommit(txFramePos);
+    txFrameSize = 0;
 }
 
 void serializeNames(const char *s)
@@ -171,17 +176,84 @@ void serialInit(uint32_t baudrate)
     uartInit(baudrate);
 }
 
+// Serial RX: with FEATURE_RX_MSP, MSP_SET_RAW_RC(_SEQ) frames are a receiver read through rcReadRawFunc.
+// Each frame triggers computeRC() on the next loop, and the sequence number of the frame that got used and its
+// age at that point are sent back with the next MSP_SET_RAW_RC_SEQ reply.
+static int16_t mspRcData[RC_CHANS];
+static bool mspRcFrameComplete = false;
+static bool mspRcDataIncoming = false;
+static uint16_t mspRcSeq = 0;           // sequence of the last received frame
+static uint32_t mspRcTime = 0;          // micros() when it was received
+static uint16_t mspRcAppliedSeq = 0;    // last frame computeRC() picked up
+static uint16_t mspRcLatency = 0;       // us from reception to computeRC() for it
+
+// true once for each received frame, also runs the serial RX link timeout
+bool mspFrameComplete(void)
+{
+    if (!feature(FEATURE_RX_MSP))
+        return false;
+
+    // own timeout, much shorter than failsafe_delay. Failsafe skips its guard time when this runs out
+    if (mspRcDataIncoming && micros() - mspRcTime > cfg.rx_msp_timeout * 1000)
+        failsafeOnRxFailsafe();
+
+    if (mspRcFrameComplete) {
+        mspRcFrameComplete = false;
+        mspRcAppliedSeq = mspRcSeq;
+        mspRcLatency = min(micros() - mspRcTime, 0xFFFF);
+        return true;
+    }
+    return false;
+}
+
+// channels are in internal RPYT+AUX order, no rcmap
+uint16_t mspReadRawRC(uint8_t chan)
+{
+    if (!mspRcDataIncoming)
+        return cfg.midrc;
+
+    return mspRcData[chan];
+}
+
+static void mspReceiveRawRC(uint8_t channels)
+{
+    uint8_t i;
+
+    if (!feature(FEATURE_RX_MSP)) {
+        // no serial RX, overrides rcData until the next computeRC()
+        for (i = 0; i < RC_CHANS && i < channels; i++)
+            rcData[i] = read16();
+        return;
+    }
+
+    for (i = 0; i < RC_CHANS && i < channels; i++)
+        mspRcData[i] = read16();
+    mspRcTime = micros();
+    mspRcDataIncoming = true;
+    mspRcFrameComplete = true;
+    failsafeOnValidFrame();
+}
+
 static void evaluateCommand(void)
 {
-    uint32_t i;
-    uint8_t wp_no;
+    uint32_t i, j;
+    uint8_t wp_no, box;
+    boxmask_t mask;
 
     switch (cmdMSP) {
     case MSP_SET_RAW_RC:
-        for (i = 0; i < 8; i++)
-            rcData[i] = read16();
+        // older senders only have 8
+        mspReceiveRawRC(dataSize / 2);
         headSerialReply(0);
         break;
+    case MSP_SET_RAW_RC_SEQ:
+        mspRcSeq = read16();
+        mspReceiveRawRC(dataSize > 2 ? (dataSize - 2) / 2 : 0);
+        headSerialReply(6);
+        serialize16(mspRcSeq);
+        serialize16(mspRcAppliedSeq);
+        serialize16(mspRcLatency);
+        break;
     case MSP_SET_ACC_TRIM:
         cfg.angleTrim[PITCH] = read16();
         cfg.angleTrim[ROLL]  = read16();
@@ -206,8 +278,26 @@ static void evaluateCommand(void)
         headSerialReply(0);
         break;
     case MSP_SET_BOX:
+        // 16 bit masks only cover AUX1..5, switches on higher AUX channels stay as they are
+        if (dataSize != CHECKBOXITEMS * 2) {
+            headSerialError(0);
+            break;
+        }
         for (i = 0; i < CHECKBOXITEMS; i++)
-            cfg.activate[i] = read16();
+            cfg.activate[i] = (cfg.activate[i] & ~(boxmask_t)0xFFFF) | (uint16_t)read16();
+        headSerialReply(0);
+        break;
+    case MSP_SET_BOX_EXT:
+        // one box per message, so the widest mask still fits INBUF_SIZE
+        box = read8();
+        if (dataSize < 2 || dataSize > 1 + sizeof(boxmask_t) || box >= CHECKBOXITEMS) {
+            headSerialError(0);
+            break;
+        }
+        mask = 0;
+        for (i = 0; i < dataSize - 1u; i++)
+            mask |= (boxmask_t)read8() << (8 * i);
+        cfg.activate[box] = mask;
         headSerialReply(0);
         break;
     case MSP_SET_RC_TUNING:
@@ -238,7 +328,7 @@ static void evaluateCommand(void)
         serialize32(f.ANGLE_MODE << BOXANGLE | f.HORIZON_MODE << BOXHORIZON | f.BARO_MODE << BOXBARO | f.MAG_MODE << BOXMAG | f.ARMED << BOXARM | 
                     rcOptions[BOXCAMSTAB] << BOXCAMSTAB | rcOptions[BOXCAMTRIG] << BOXCAMTRIG | 
                     f.GPS_HOME_MODE << BOXGPSHOME | f.GPS_HOLD_MODE << BOXGPSHOLD | f.HEADFREE_MODE << BOXHEADFREE | f.PASSTHRU_MODE << BOXPASSTHRU | 
-                    rcOptions[BOXBEEPERON] << BOXBEEPERON | rcOptions[BOXLEDMAX] << BOXLEDMAX | rcOptions[BOXLLIGHTS] << BOXLLIGHTS | rcOptions[BOXHEADADJ] << BOXHEADADJ);
+                    rcOptions[BOXBEEPERON] << BOXBEEPERON | rcOptions[BOXLEDMAX] << BOXLEDMAX | rcOptions[BOXLLIGHTS] << BOXLLIGHTS | rcOptions[BOXHEADADJ] << BOXHEADADJ | (autotune.state == AUTOTUNE_RUNNING) << BOXAUTOTUNE);
         break;
     case MSP_RAW_IMU:
         headSerialReply(18);
@@ -260,8 +350,8 @@ static void evaluateCommand(void)
             serialize16(motor[i]);
         break;
     case MSP_RC:
-        headSerialReply(16);
-        for (i = 0; i < 8; i++)
+        headSerialReply(2 * RC_CHANS);
+        for (i = 0; i < RC_CHANS; i++)
             serialize16(rcData[i]);
         break;
     case MSP_RAW_GPS:
@@ -291,9 +381,11 @@ static void evaluateCommand(void)
         serialize32(EstAlt);
         break;
     case MSP_BAT:
-        headSerialReply(3);
+        headSerialReply(7);
         serialize8(vbat);
-        serialize16(0); // power meter trash
+        serialize16(min(mAhDrawn, 0xFFFF));
+        serialize16(0); // rssi, not measured
+        serialize16(amperage);
         break;
     case MSP_RC_TUNING:
         headSerialReply(7);
@@ -314,10 +406,19 @@ static void evaluateCommand(void)
         }
         break;
     case MSP_BOX:
+        // the layout every configurator reads, AUX1..5
         headSerialReply(2 * CHECKBOXITEMS);
         for (i = 0; i < CHECKBOXITEMS; i++)
             serialize16(cfg.activate[i]);
         break;
+    case MSP_BOX_EXT:
+        headSerialReply(1 + sizeof(boxmask_t) * CHECKBOXITEMS);
+        serialize8(sizeof(boxmask_t));
+        for (i = 0; i < CHECKBOXITEMS; i++) {
+            for (j = 0; j < sizeof(boxmask_t); j++)
+                serialize8(cfg.activate[i] >> (8 * j));
+        }
+        break;
     case MSP_BOXNAMES:
         headSerialReply(sizeof(boxnames) - 1);
         serializeNames(boxnames);
@@ -373,6 +474,33 @@ static void evaluateCommand(void)
         serialize16(cfg.angleTrim[PITCH]);
         serialize16(cfg.angleTrim[ROLL]);
         break;
+    case MSP_FAILSAFE:
+        headSerialReply(13);
+        serialize8(failsafe.stage);
+        serialize16(failsafeCnt);
+        serialize16(failsafe.frameRate);
+        serialize16(failsafe.glitches);
+        serialize32(failsafe.channelValid);
+        serialize16(failsafeEvents);
+        break;
+    case MSP_I2C_STATS:
+        for (i = 0; i2cGetDeviceStats(i) != NULL; i++);
+        headSerialReply(5 + 15 * i);
+        serialize16(i2cGetClockSpeed());
+        serialize16(i2cGetErrorCounter());
+        serialize8(i);
+        for (i = 0; i2cGetDeviceStats(i) != NULL; i++) {
+            const i2cDeviceStats_t *dev = i2cGetDeviceStats(i);
+            serialize8(dev->addr);
+            serialize16(dev->transfers);
+            serialize16(dev->errors);
+            serialize16(dev->timeouts);
+            serialize16(dev->retries);
+            serialize16(dev->lastTime);
+            serialize16(dev->maxTime);
+            serialize16(dev->transfers ? dev->totalTime / dev->transfers : 0);
+        }
+        break;
     case MSP_DEBUG:
         headSerialReply(8);
         for (i = 0; i < 4; i++)
@@ -402,7 +530,6 @@ void serialCom(void)
 {
     uint8_t c;
     static uint8_t offset;
-    static uint8_t dataSize;
     static enum _serial_state {
         IDLE,
         HEADER_START,
@@ -3,20 +3,26 @@
 
 // driver for spektrum satellite receiver / sbus using UART2 (freeing up more motor outputs for stuff)
 
-#define SPEK_MAX_CHANNEL 7
+#define SPEK_MAX_CHANNEL 12         // DSMX 2048 sends up to 12, 7 per frame
 #define SPEK_FRAME_SIZE 16
 static uint8_t spek_chan_shift;
 static uint8_t spek_chan_mask;
 static bool rcFrameComplete = false;
 static bool spekDataIncoming = false;
-volatile uint8_t spekFrame[SPEK_FRAME_SIZE];
+static uint8_t spekFrame[SPEK_FRAME_SIZE];
+static uint16_t spekChannelData[SPEK_MAX_CHANNEL];     // us
+static uint32_t spekFrameTime = 0;                      // micros() when the last frame finished
+static uint32_t spekFrameInterval = 0;                  // us between the last two frames, 11000 or 22000 normally
 static void spektrumDataReceive(uint16_t c);
 
-// external vars (ugh)
-extern int16_t failsafeCnt;
-
 void spektrumInit(void)
 {
+    int i;
+
+    // channels the satellite never sends stay centered
+    for (i = 0; i < SPEK_MAX_CHANNEL; i++)
+        spekChannelData[i] = cfg.midrc;
+
     if (cfg.spektrum_hires) {
         // 11 bit frames
         spek_chan_shift = 3;
@@ -30,58 +36,75 @@ void spektrumInit(void)
     uart2Init(115200, spektrumDataReceive, true);
 }
 
-// UART2 Receive ISR callback
-static void spektrumDataReceive(uint16_t c)
+// 2 bytes of header, then 7 servo words of channel id + position. Unused slots are 0xFFFF and fall out on the id check
+static void spektrumDecodeFrame(void)
 {
-    uint32_t spekTime;
-    static uint32_t spekTimeLast, spekTimeInterval;
-    static uint8_t  spekFramePosition;
+    uint32_t now = micros();
+    uint16_t value;
+    uint8_t b, spekChannel;
 
+    for (b = 3; b < SPEK_FRAME_SIZE; b += 2) {
+        spekChannel = 0x0F & (spekFrame[b - 1] >> spek_chan_shift);
+        if (spekChannel < SPEK_MAX_CHANNEL) {
+            value = ((uint16_t)(spekFrame[b - 1] & spek_chan_mask) << 8) + spekFrame[b];
+            if (cfg.spektrum_hires)
+                spekChannelData[spekChannel] = 988 + (value >> 1);  // 2048 mode
+            else
+                spekChannelData[spekChannel] = 988 + value;         // 1024 mode
+        }
+    }
+
+    if (spekDataIncoming)
+        spekFrameInterval = now - spekFrameTime;
+    spekFrameTime = now;
     spekDataIncoming = true;
-    spekTime = micros();
-    spekTimeInterval = spekTime - spekTimeLast;
-    spekTimeLast = spekTime;
-    if (spekTimeInterval > 5000) 
+    rcFrameComplete = true;
+    failsafeOnValidFrame();
+}
+
+// UART2 receive callback, called from main loop by uart2Poll()
+static void spektrumDataReceive(uint16_t c)
+{
+    static uint8_t spekFramePosition = 0;
+
+    // bytes within a frame are back to back, the line goes idle between frames
+    if (c == UART_FRAME_END) {
         spekFramePosition = 0;
-    spekFrame[spekFramePosition] = (uint8_t)c;
-    if (spekFramePosition == SPEK_FRAME_SIZE - 1) {
-        rcFrameComplete = true;
-        failsafeCnt = 0;   // clear FailSafe counter
-    } else {
-        spekFramePosition++;
+        return;
     }
+
+    if (spekFramePosition >= SPEK_FRAME_SIZE)
+        return;
+
+    spekFrame[spekFramePosition++] = (uint8_t)c;
+    if (spekFramePosition == SPEK_FRAME_SIZE)
+        spektrumDecodeFrame();
 }
 
+// true once for each decoded frame
 bool spektrumFrameComplete(void)
 {
-    return rcFrameComplete;
+    if (rcFrameComplete) {
+        rcFrameComplete = false;
+        return true;
+    }
+    return false;
 }
 
-// static const uint8_t spekRcChannelMap[SPEK_MAX_CHANNEL] = {1, 2, 3, 0, 4, 5, 6};
+uint32_t spektrumGetFrameTime(void)
+{
+    return spekFrameTime;
+}
 
-uint16_t spektrumReadRawRC(uint8_t chan)
+uint32_t spektrumGetFrameInterval(void)
 {
-    uint16_t data;
-    static uint32_t spekChannelData[SPEK_MAX_CHANNEL];
-    uint8_t b;
+    return spekFrameInterval;
+}
 
-    if (rcFrameComplete) {
-        for (b = 3; b < SPEK_FRAME_SIZE; b += 2) {
-            uint8_t spekChannel = 0x0F & (spekFrame[b - 1] >> spek_chan_shift);
-            if (spekChannel < SPEK_MAX_CHANNEL) 
-                spekChannelData[spekChannel] = ((uint32_t)(spekFrame[b - 1] & spek_chan_mask) << 8) + spekFrame[b];
-        }
-        rcFrameComplete = false;
-    }
+uint16_t spektrumReadRawRC(uint8_t chan)
+{
+    if (!spekDataIncoming || cfg.rcmap[chan] >= SPEK_MAX_CHANNEL)
+        return cfg.midrc;
 
-    if (chan >= SPEK_MAX_CHANNEL || !spekDataIncoming) {
-        data = cfg.midrc;
-    } else {
-        if (cfg.spektrum_hires)
-            data = 988 + (spekChannelData[cfg.rcmap[chan]] >> 1);   // 2048 mode
-        else
-            data = 988 + spekChannelData[cfg.rcmap[chan]];          // 1024 mode
-    }
-    
-    return data;
+    return spekChannelData[cfg.rcmap[chan]];
 }
@@ -44,11 +44,24 @@
 #define ID_GYRO_X             0x40
 #define ID_GYRO_Y             0x41
 #define ID_GYRO_Z             0x42
+#define ID_RX_FRAMERATE       0x43
+#define ID_FAILSAFE           0x44
+
+// header + id + 2 data bytes, each of them may be stuffed to 2 bytes
+#define DATA_FRAME_SIZE       6
+
+// each value is built in place in the uart tx buffer, sendDataHead() reserves room and serialize16() commits it
+static uint8_t *dataFrame;
+static uint8_t dataFramePos;
 
 static void sendDataHead(uint8_t id)
 {
-    uartWrite(PROTOCOL_HEADER);
-    uartWrite(id);
+    dataFrame = uartTxReserve(DATA_FRAME_SIZE);
+    if (dataFrame) {
+        dataFrame[0] = PROTOCOL_HEADER;
+        dataFrame[1] = id;
+    }
+    dataFramePos = 2;
 }
 
 static void sendTelemetryTail(void)
@@ -60,22 +73,26 @@ static void serializeFrsky(uint8_t data)
 {
     // take care of byte stuffing
     if (data == 0x5e) {
-        uartWrite(0x5d);
-        uartWrite(0x3e);
+        dataFrame[dataFramePos++] = 0x5d;
+        dataFrame[dataFramePos++] = 0x3e;
     } else if (data == 0x5d) {
-        uartWrite(0x5d);
-        uartWrite(0x3d);
+        dataFrame[dataFramePos++] = 0x5d;
+        dataFrame[dataFramePos++] = 0x3d;
     } else
-        uartWrite(data);
+        dataFrame[dataFramePos++] = data;
 }
 
 static void serialize16(int16_t a)
 {
     uint8_t t;
+
+    if (!dataFrame)
+        return;
     t = a;
     serializeFrsky(t);
     t = a >> 8 & 0xff;
     serializeFrsky(t);
+    uartTxCommit(dataFramePos);
 }
 
 static void sendAccel(void)
@@ -102,6 +119,14 @@ static void sendTemperature1(void)
     serialize16(telemTemperature1 / 10);
 }
 
+static void sendRxStatus(void)
+{
+    sendDataHead(ID_RX_FRAMERATE);
+    serialize16(failsafe.frameRate);
+    sendDataHead(ID_FAILSAFE);
+    serialize16(failsafe.stage);
+}
+
 static void sendTime(void)
 {
     uint32_t seconds = millis() / 1000;
@@ -144,6 +169,17 @@ static void sendVoltage(void)
     serialize16(((voltage % 100) + 5) / 10);
 }
 
+static void sendCurrent(void)
+{
+    sendDataHead(ID_CURRENT);
+    serialize16(amperage / 10); // 0.1A
+    // remaining capacity in percent
+    if (cfg.batterycapacity) {
+        sendDataHead(ID_FUEL_LEVEL);
+        serialize16(100 - min(mAhDrawn * 100 / cfg.batterycapacity, 100));
+    }
+}
+
 static void sendHeading(void)
 {
     sendDataHead(ID_COURSE_BP);
@@ -186,8 +222,11 @@ void sendTelemetry(void)
 
         if ((cycleNum % 8) == 0) {      // Sent every 1s
             sendTemperature1();
+            sendRxStatus();
             if (feature(FEATURE_VBAT))
                 sendVoltage();
+            if (feature(FEATURE_POWERMETER) && cfg.power_adc_channel)
+                sendCurrent();
             if (sensors(SENSOR_GPS))
                 sendGPS();
             sendTelemetryTail();
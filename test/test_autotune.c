@@ -0,0 +1,256 @@
+// Host test for autotune.c: the relay run on a simulated roll and pitch axis, Ku/Tu against the plant's
+// analytic ultimate gain and period, and the P8/I8/D8 every autotune_rule makes from them.
+
+#include <stdint.h>
+#include "unittest.h"
+
+// micros() runs off this instead of the DWT counter
+volatile uint32_t hostCycles;
+#define DWT_CYCCNT hostCycles
+
+#include "autotune.c"
+
+// used by autotune.c
+config_t cfg;
+flags_t f;
+int16_t gyroData[3];
+int16_t angle[2];
+int16_t axisPID[3];
+uint8_t rcOptions[CHECKBOXITEMS];
+uint16_t cycleTime;
+uint32_t usTicks = 72;
+uint32_t usTicksInv = ((1ULL << 32) + 72 - 1) / 72;
+volatile uint32_t sysTickUptime;
+volatile uint32_t sysTickCycles;
+
+static bool accPresent = false;
+static int integralResets = 0;
+
+bool sensors(uint32_t mask)
+{
+    return accPresent && mask == SENSOR_ACC;
+}
+
+void pidResetIntegrals(void)
+{
+    integralResets++;
+}
+
+#define LOOPTIME        3500        // us
+#define GYRO_LSB_DPS    (1998.0f / (32767.0f / 4.0f))
+#define PLANT_DELAY     2           // loops between axisPID and the motors reacting
+
+// Rate of one axis in gyroData LSB: motor lag, then the airframe's first order response, after a dead time.
+typedef struct plant_t {
+    float gain;                     // deg/s per axisPID unit at steady state
+    float motorTau;                 // s
+    float airframeTau;              // s
+    int16_t delayed[PLANT_DELAY];
+    float motor;
+    float rate;                     // gyro LSB
+} plant_t;
+
+static void plantStep(plant_t *plant, int16_t input, float dt)
+{
+    int16_t u = plant->delayed[0];
+    int k;
+
+    for (k = 0; k < PLANT_DELAY - 1; k++)
+        plant->delayed[k] = plant->delayed[k + 1];
+    plant->delayed[PLANT_DELAY - 1] = input;
+    for (k = 0; k < 10; k++) {
+        plant->motor += (u - plant->motor) / plant->motorTau * dt / 10;
+        plant->rate += (plant->gain / GYRO_LSB_DPS * plant->motor - plant->rate) / plant->airframeTau * dt / 10;
+    }
+}
+
+// Gain and phase lag of the plant at w rad/s, the dead time being PLANT_DELAY loops plus half a loop for the
+// output being held.
+static float plantResponse(const plant_t *plant, float w, float dt, float *lag)
+{
+    *lag = atanf(w * plant->motorTau) + atanf(w * plant->airframeTau) + w * (PLANT_DELAY + 0.5f) * dt;
+    return plant->gain / GYRO_LSB_DPS / (sqrtf(1 + w * w * plant->motorTau * plant->motorTau) * sqrtf(1 + w * w * plant->airframeTau * plant->airframeTau));
+}
+
+// Ku and Tu the relay should find by its describing function. With hysteresis h the limit cycle is where the
+// plant's Nyquist curve crosses Im = -pi * h / (4 * relay), a little before -180 degrees, found by bisection
+// between -90 and -180. Ku in axisPID per gyro LSB, Tu in s.
+static void plantUltimate(const plant_t *plant, float dt, float *ku, float *tu)
+{
+    float low = 0.1f, high = 1000.0f, w = 0.0f, gain = 0.0f, lag;
+    int n;
+
+    for (n = 0; n < 60; n++) {
+        w = (low + high) / 2;
+        gain = plantResponse(plant, w, dt, &lag);
+        if (lag < M_PI / 2 || (lag < M_PI && gain * sinf(lag) > M_PI * AUTOTUNE_HYSTERESIS / (4.0f * cfg.autotune_relay)))
+            low = w;
+        else
+            high = w;
+    }
+    *ku = 1.0f / gain;
+    *tu = 2 * M_PI / w;
+}
+
+static plant_t plants[2];
+
+static void resetAutotune(void)
+{
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&f, 0, sizeof(f));
+    memset(&autotune, 0, sizeof(autotune));
+    memset(plants, 0, sizeof(plants));
+    memset(rcOptions, 0, sizeof(rcOptions));
+    memset(gyroData, 0, sizeof(gyroData));
+    memset(angle, 0, sizeof(angle));
+    cfg.autotune_relay = 100;
+    cfg.P8[ROLL] = cfg.P8[PITCH] = 40;
+    cfg.I8[ROLL] = cfg.I8[PITCH] = 30;
+    cfg.D8[ROLL] = cfg.D8[PITCH] = 23;
+    // pitch has more inertia than roll, slow enough for I8 of the gentlest rule to stay below its limit
+    plants[ROLL].gain = 8.0f;
+    plants[ROLL].motorTau = 0.04f;
+    plants[ROLL].airframeTau = 0.4f;
+    plants[PITCH].gain = 6.0f;
+    plants[PITCH].motorTau = 0.05f;
+    plants[PITCH].airframeTau = 0.5f;
+    cycleTime = LOOPTIME;
+    accPresent = false;
+    integralResets = 0;
+    f.ARMED = 1;
+}
+
+// One loop of the flight controller as far as autotune is concerned: gyro in, PID (idle here) and autotune,
+// then the airframe moves for a loop.
+static void runLoop(void)
+{
+    int axis;
+
+    for (axis = 0; axis < 2; axis++) {
+        gyroData[axis] = lrintf(plants[axis].rate);
+        axisPID[axis] = 0;
+    }
+    autotuneUpdate();
+    for (axis = 0; axis < 2; axis++)
+        plantStep(&plants[axis], axisPID[axis], LOOPTIME * 1e-6f);
+    hostCycles += LOOPTIME * usTicks;
+}
+
+// box off, then on: the run goes through ROLL and PITCH and stops
+static void runAutotune(void)
+{
+    int n;
+
+    rcOptions[BOXAUTOTUNE] = 0;
+    runLoop();
+    rcOptions[BOXAUTOTUNE] = 1;
+    for (n = 0; n < 2 * AUTOTUNE_TIMEOUT / LOOPTIME; n++) {
+        runLoop();
+        if (autotune.state != AUTOTUNE_RUNNING)
+            break;
+    }
+}
+
+// The relay finds Ku and Tu of both axes close to the describing function values, which only hold exactly for a
+// sine and leave a few percent for peak detection on a sampled, quantized gyro.
+static void testAutotuneRelay(void)
+{
+    float ku, tu;
+    int axis;
+
+    resetAutotune();
+    runAutotune();
+    CHECK(autotune.state == AUTOTUNE_IDLE, "state %d after the run", autotune.state);
+    CHECK(autotune.done == ((1 << ROLL) | (1 << PITCH)), "done mask %d", autotune.done);
+    CHECK(integralResets == 2, "integrals reset %d times, once per axis expected", integralResets);
+    for (axis = 0; axis < 2; axis++) {
+        plantUltimate(&plants[axis], LOOPTIME * 1e-6f, &ku, &tu);
+        testPrint("autotune axis %d: Ku %.3f (plant %.3f), Tu %.1fms (plant %.1fms), P8 %d I8 %d D8 %d\n", axis,
+            autotune.ku[axis], ku, autotune.tu[axis] * 1000, tu * 1000, autotune.P8[axis], autotune.I8[axis], autotune.D8[axis]);
+        CHECK(fabsf(autotune.ku[axis] - ku) < 0.1f * ku, "axis %d: Ku %.3f, plant %.3f", axis, autotune.ku[axis], ku);
+        CHECK(fabsf(autotune.tu[axis] - tu) < 0.05f * tu, "axis %d: Tu %.4f, plant %.4f", axis, autotune.tu[axis], tu);
+    }
+
+    // candidates only reach cfg through autotuneApply()
+    CHECK(cfg.P8[ROLL] == 40 && cfg.I8[ROLL] == 30 && cfg.D8[ROLL] == 23, "cfg changed before apply");
+    CHECK(autotuneApply(), "apply refused");
+    for (axis = 0; axis < 2; axis++) {
+        CHECK(cfg.P8[axis] == autotune.P8[axis] && cfg.I8[axis] == autotune.I8[axis] && cfg.D8[axis] == autotune.D8[axis],
+            "axis %d: cfg %d/%d/%d", axis, cfg.P8[axis], cfg.I8[axis], cfg.D8[axis]);
+    }
+    CHECK(!autotuneApply(), "second apply accepted");
+}
+
+// Every rule turns the measured Ku/Tu into the gains of its Kp/Ti/Td in MultiWii units, and those stay within
+// reach of what the plant's analytic Ku/Tu would give.
+static void testAutotuneRules(void)
+{
+    float ku, tu, kp, ti, td, dt = LOOPTIME * 1e-6f;
+    uint8_t rule, p, i, d, p2, i2, d2;
+    int axis;
+
+    for (rule = 0; rule < sizeof(autotuneRules) / sizeof(autotuneRules[0]); rule++) {
+        resetAutotune();
+        cfg.autotune_rule = rule;
+        runAutotune();
+        for (axis = 0; axis < 2; axis++) {
+            // exactly the rule applied to what was measured
+            kp = autotuneRules[rule][0] * autotune.ku[axis];
+            ti = autotuneRules[rule][1] * autotune.tu[axis];
+            td = autotuneRules[rule][2] * autotune.tu[axis];
+            CHECK(autotune.P8[axis] == (uint8_t)constrain(kp * 80.0f + 0.5f, 0, 200), "rule %d axis %d: P8 %d", rule, axis, autotune.P8[axis]);
+            CHECK(autotune.I8[axis] == (uint8_t)constrain(kp / ti * 8000.0f * dt + 0.5f, 0, 200), "rule %d axis %d: I8 %d", rule, axis, autotune.I8[axis]);
+            CHECK(autotune.D8[axis] == (uint8_t)constrain(kp * td * 32.0f / (3.0f * dt) + 0.5f, 0, 200), "rule %d axis %d: D8 %d", rule, axis, autotune.D8[axis]);
+
+            // and close to the plant's own numbers
+            plantUltimate(&plants[axis], dt, &ku, &tu);
+            autotuneComputeGains(ku, tu, dt, rule, &p, &i, &d);
+            testPrint("autotune rule %d axis %d: P8 %d I8 %d D8 %d, from the plant %d %d %d\n", rule, axis,
+                autotune.P8[axis], autotune.I8[axis], autotune.D8[axis], p, i, d);
+            CHECK(abs(autotune.P8[axis] - p) <= p / 5 + 1, "rule %d axis %d: P8 %d, plant %d", rule, axis, autotune.P8[axis], p);
+            CHECK(abs(autotune.I8[axis] - i) <= i / 5 + 1, "rule %d axis %d: I8 %d, plant %d", rule, axis, autotune.I8[axis], i);
+            CHECK(abs(autotune.D8[axis] - d) <= d / 5 + 1, "rule %d axis %d: D8 %d, plant %d", rule, axis, autotune.D8[axis], d);
+        }
+    }
+
+    // the rules order from aggressive to gentle
+    autotuneComputeGains(autotune.ku[ROLL], autotune.tu[ROLL], dt, 0, &p, &i, &d);
+    autotuneComputeGains(autotune.ku[ROLL], autotune.tu[ROLL], dt, 2, &p2, &i2, &d2);
+    CHECK(p > p2 && i > i2, "rule 0 %d/%d not above rule 2 %d/%d", p, i, p2, i2);
+}
+
+// Tilting past AUTOTUNE_MAX_ANGLE or switching the box off stops the run without touching any gains.
+static void testAutotuneAbort(void)
+{
+    int n;
+
+    resetAutotune();
+    accPresent = true;
+    rcOptions[BOXAUTOTUNE] = 0;
+    runLoop();
+    rcOptions[BOXAUTOTUNE] = 1;
+    for (n = 0; n < 20; n++)
+        runLoop();
+    CHECK(autotune.state == AUTOTUNE_RUNNING, "not running but %d", autotune.state);
+    angle[ROLL] = AUTOTUNE_MAX_ANGLE + 1;
+    runLoop();
+    CHECK(autotune.state == AUTOTUNE_FAILED && !autotune.done, "tilted: state %d, done %d", autotune.state, autotune.done);
+
+    // switching on again without switching off first does not restart
+    angle[ROLL] = 0;
+    runLoop();
+    CHECK(autotune.state == AUTOTUNE_FAILED, "restarted without a box toggle, state %d", autotune.state);
+
+    rcOptions[BOXAUTOTUNE] = 0;
+    runLoop();
+    CHECK(autotune.state == AUTOTUNE_IDLE && autotune.ready, "box off: state %d, ready %d", autotune.state, autotune.ready);
+    CHECK(cfg.P8[ROLL] == 40 && cfg.P8[PITCH] == 40, "gains changed by an aborted run");
+}
+
+int main(void)
+{
+    testAutotuneRelay();
+    testAutotuneRules();
+    testAutotuneAbort();
+    return testDone("autotune");
+}
@@ -0,0 +1,86 @@
+// Host test for dshot.c: packets against known frames, the motor pulse to throttle mapping and the
+// compare values dshotEncode() leaves in an interleaved DMA buffer.
+
+#include "unittest.h"
+#include "dshot.c"
+
+static void testDshotPacket(void)
+{
+    static const struct {
+        uint16_t throttle;
+        bool telemetry;
+        uint16_t packet;
+    } frames[] = {
+        { 1046, false, 0x82C6 },        // the reference frame
+        { 1046, true,  0x82D7 },
+        { 0,    false, 0x0000 },        // motor stop
+        { 48,   false, 0x0606 },
+        { 2047, false, 0xFFEE },
+        { 2047, true,  0xFFFF },
+    };
+    uint8_t i;
+
+    for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++)
+        CHECK(dshotPacket(frames[i].throttle, frames[i].telemetry) == frames[i].packet, "throttle %d telemetry %d: 0x%04X, expected 0x%04X",
+            frames[i].throttle, frames[i].telemetry, dshotPacket(frames[i].throttle, frames[i].telemetry), frames[i].packet);
+}
+
+// 1000us and below stop the motor, anything above starts at 48 past the command range and ends at 2047
+static void testDshotThrottle(void)
+{
+    uint16_t pulse, throttle, last = 0;
+
+    CHECK(dshotThrottle(0) == 0, "0us: %d", dshotThrottle(0));
+    CHECK(dshotThrottle(1000) == 0, "1000us: %d", dshotThrottle(1000));
+    CHECK(dshotThrottle(1001) == DSHOT_MIN_THROTTLE + 1, "1001us: %d", dshotThrottle(1001));
+    CHECK(dshotThrottle(1500) == 1047, "1500us: %d", dshotThrottle(1500));
+    CHECK(dshotThrottle(2000) == DSHOT_MAX_THROTTLE, "2000us: %d", dshotThrottle(2000));
+    CHECK(dshotThrottle(2500) == DSHOT_MAX_THROTTLE, "2500us: %d", dshotThrottle(2500));
+    CHECK(dshotThrottle(0xFFFF) == DSHOT_MAX_THROTTLE, "65535us: %d", dshotThrottle(0xFFFF));
+
+    // never a special command, never going down
+    for (pulse = 1001; pulse <= 2100; pulse++) {
+        throttle = dshotThrottle(pulse);
+        if (throttle < DSHOT_MIN_THROTTLE || throttle > DSHOT_MAX_THROTTLE || throttle < last) {
+            CHECK(false, "%dus: %d after %d", pulse, throttle, last);
+            break;
+        }
+        last = throttle;
+    }
+}
+
+// One channel of a 4 channel burst buffer: its slots get the bits MSB first, then zero padding, and the other
+// channels' slots stay untouched.
+static void testDshotEncode(void)
+{
+    uint16_t buffer[DSHOT_BUFFER_LENGTH * 4 + 4];
+    uint16_t packet = 0x82C6, expected;
+    uint8_t channel, i;
+
+    for (channel = 0; channel < 4; channel++) {
+        for (i = 0; i < sizeof(buffer) / sizeof(buffer[0]); i++)
+            buffer[i] = 0xAAAA;
+        dshotEncode(packet, buffer + channel, 4);
+        for (i = 0; i < sizeof(buffer) / sizeof(buffer[0]); i++) {
+            if (i % 4 != channel || i >= DSHOT_BUFFER_LENGTH * 4)
+                expected = 0xAAAA;
+            else if (i / 4 >= DSHOT_FRAME_BITS)
+                expected = 0;
+            else
+                expected = (packet << (i / 4)) & 0x8000 ? DSHOT_BIT_1 : DSHOT_BIT_0;
+            CHECK(buffer[i] == expected, "channel %d slot %d: %d, expected %d", channel, i, buffer[i], expected);
+        }
+    }
+
+    // 37.5% and 75% duty of a bit
+    CHECK(DSHOT_BIT_0 * 1000 / DSHOT_BIT_TICKS == 375 && DSHOT_BIT_1 * 100 / DSHOT_BIT_TICKS == 75, "bit widths %d/%d of %d",
+        DSHOT_BIT_0, DSHOT_BIT_1, DSHOT_BIT_TICKS);
+}
+
+int main(void)
+{
+    testDshotPacket();
+    testDshotThrottle();
+    testDshotEncode();
+    return testDone("dshot");
+}
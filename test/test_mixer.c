@@ -0,0 +1,412 @@
+// Host test for mixer.c: the fixed point motor mix of every mixers[] entry against the float formula,
+// the airplane servo mix and the helicopter swash geometry.
+
+#include "unittest.h"
+#include "mixer.c"
+
+// used by mixer.c
+config_t cfg;
+flags_t f;
+int16_t angle[2];
+int16_t axisPID[3];
+int16_t rcCommand[4];
+int16_t rcData[RC_CHANS];
+uint8_t rcOptions[CHECKBOXITEMS];
+uint16_t vbatCompensation = 1024;
+
+bool feature(uint32_t mask)
+{
+    return false;
+}
+
+void pwmWriteMotor(uint8_t index, uint16_t value) { }
+void pwmCompleteMotorUpdate(void) { }
+void pwmWriteServo(uint8_t index, uint16_t value) { }
+bool pwmServoFrameStart(void) { return false; }
+
+static uint32_t seed = 1;
+
+// same sequence on every host, unlike rand()
+static int32_t randomRange(int32_t low, int32_t high)
+{
+    seed = seed * 1103515245 + 12345;
+    return low + (int32_t)((seed >> 8) % (uint32_t)(high - low + 1));
+}
+
+static void resetConfig(void)
+{
+    int i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&f, 0, sizeof(f));
+    cfg.minthrottle = 1150;
+    cfg.maxthrottle = 1850;
+    cfg.mincommand = 1000;
+    cfg.mincheck = 1100;
+    cfg.midrc = 1500;
+    cfg.yaw_direction = 1;
+    for (i = 0; i < 8; i++) {
+        cfg.servoreverse[i] = 1;
+        cfg.servoendpoint_low[i] = 1000;
+        cfg.servoendpoint_high[i] = 2000;
+    }
+    for (i = 0; i < RC_CHANS; i++)
+        rcData[i] = cfg.midrc;
+    f.ARMED = 1;
+    rcData[THROTTLE] = 1500;
+    vbatCompensation = 1024;
+}
+
+static void setupMixer(uint8_t type)
+{
+    cfg.mixerConfiguration = type;
+    numberMotor = 0;
+    mixerInit();
+}
+
+// What mixMotors() and the end of mixTable() do, in float: vbat compensation, PID range scaling,
+// shift down from maxthrottle, shift up from minthrottle with mixer_airmode, clip.
+static void referenceMix(const motorMixer_t *mix, int count, float *out)
+{
+    float comp = vbatCompensation / 1024.0f;
+    float throttle = cfg.minthrottle + (rcCommand[THROTTLE] - cfg.minthrottle) * comp;
+    float pid[MAX_MOTORS], pidMin = 0, pidMax = 0, maxMotor, minMotor;
+    float span = cfg.maxthrottle - cfg.minthrottle;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        pid[i] = (axisPID[PITCH] * mix[i].pitch + axisPID[ROLL] * mix[i].roll + cfg.yaw_direction * axisPID[YAW] * mix[i].yaw) * comp;
+        if (i == 0 || pid[i] < pidMin)
+            pidMin = pid[i];
+        if (i == 0 || pid[i] > pidMax)
+            pidMax = pid[i];
+    }
+    for (i = 0; i < count; i++) {
+        if (pidMax - pidMin > span)
+            pid[i] = pid[i] * span / (pidMax - pidMin);
+        out[i] = throttle * mix[i].throttle + pid[i];
+    }
+    maxMotor = minMotor = out[0];
+    for (i = 1; i < count; i++) {
+        maxMotor = max(maxMotor, out[i]);
+        minMotor = min(minMotor, out[i]);
+    }
+    for (i = 0; i < count; i++) {
+        if (maxMotor > cfg.maxthrottle)
+            out[i] -= maxMotor - cfg.maxthrottle;
+        else if (minMotor < cfg.minthrottle && cfg.mixer_airmode)
+            out[i] += cfg.minthrottle - minMotor;
+        out[i] = constrain(out[i], cfg.minthrottle, cfg.maxthrottle);
+    }
+}
+
+// Random sticks and PID for every multirotor entry, with both yaw directions, mixer_airmode on and off
+// and with battery compensation. Each rounding step may add half a unit, so up to 2.5us off the float mix.
+static void testMixerSweep(void)
+{
+    static const uint16_t vbat[] = { 1024, 1229 };
+    float expected[MAX_MOTORS];
+    uint8_t type;
+    int yaw, airmode, v, n, i;
+
+    for (type = 1; type < MULTITYPE_LAST; type++) {
+        const mixer_t *mixer = &mixers[type];
+        float worst = 0;
+
+        if (!mixer->motor || mixer->numberMotor < 2)
+            continue;
+        for (yaw = -1; yaw <= 1; yaw += 2) {
+            for (airmode = 0; airmode <= 1; airmode++) {
+                for (v = 0; v < 2; v++) {
+                    resetConfig();
+                    cfg.yaw_direction = yaw;
+                    cfg.mixer_airmode = airmode;
+                    vbatCompensation = vbat[v];
+                    setupMixer(type);
+                    CHECK(numberMotor == mixer->numberMotor, "type %d: %d motors, expected %d", type, numberMotor, mixer->numberMotor);
+
+                    for (n = 0; n < 2000; n++) {
+                        rcCommand[THROTTLE] = randomRange(cfg.minthrottle, 2000);
+                        rcCommand[YAW] = randomRange(-500, 500);
+                        axisPID[ROLL] = randomRange(-500, 500);
+                        axisPID[PITCH] = randomRange(-500, 500);
+                        axisPID[YAW] = randomRange(-500, 500);
+                        mixTable();
+                        // mixTable() limits yaw for 4+ motors before mixing, the reference uses what it mixed
+                        referenceMix(mixer->motor, mixer->numberMotor, expected);
+                        for (i = 0; i < mixer->numberMotor; i++)
+                            worst = max(worst, fabsf(motor[i] - expected[i]));
+                    }
+                }
+            }
+        }
+        CHECK(worst <= 2.5f, "type %d: motor off by %.1f from the float mix", type, worst);
+    }
+}
+
+// Quad X at minthrottle with a roll demand: clipped on the low side unless mixer_airmode lifts the mix.
+static void testMixerAirmode(void)
+{
+    int16_t lowest, highest;
+    int airmode, i;
+
+    for (airmode = 0; airmode <= 1; airmode++) {
+        resetConfig();
+        cfg.mixer_airmode = airmode;
+        setupMixer(MULTITYPE_QUADX);
+        rcCommand[THROTTLE] = cfg.minthrottle;
+        axisPID[ROLL] = 100;
+        axisPID[PITCH] = axisPID[YAW] = 0;
+        mixTable();
+        lowest = highest = motor[0];
+        for (i = 1; i < 4; i++) {
+            lowest = min(lowest, motor[i]);
+            highest = max(highest, motor[i]);
+        }
+        CHECK(lowest == cfg.minthrottle, "airmode %d: lowest motor %d", airmode, lowest);
+        CHECK(highest == cfg.minthrottle + (airmode ? 200 : 100), "airmode %d: highest motor %d", airmode, highest);
+    }
+}
+
+// PID demand wider than the throttle range is scaled down to fit instead of being clipped on both ends.
+static void testMixerPidScaling(void)
+{
+    int16_t lowest, highest;
+    int i;
+
+    resetConfig();
+    setupMixer(MULTITYPE_QUADX);
+    rcCommand[THROTTLE] = 1500;
+    axisPID[ROLL] = 500;
+    axisPID[PITCH] = 500;
+    axisPID[YAW] = 0;
+    mixTable();
+    lowest = highest = motor[0];
+    for (i = 1; i < 4; i++) {
+        lowest = min(lowest, motor[i]);
+        highest = max(highest, motor[i]);
+    }
+    CHECK(lowest == cfg.minthrottle && highest == cfg.maxthrottle, "motors %d..%d", lowest, highest);
+}
+
+// Airplane: sticks go straight to the servos in passthru, the PID output otherwise.
+static void testAirplanePassthru(void)
+{
+    resetConfig();
+    setupMixer(MULTITYPE_AIRPLANE);
+    rcCommand[ROLL] = 100;
+    rcCommand[PITCH] = -200;
+    rcCommand[YAW] = 50;
+    axisPID[ROLL] = -30;
+    axisPID[PITCH] = 40;
+    axisPID[YAW] = -60;
+
+    f.PASSTHRU_MODE = 1;
+    airplaneMixer();
+    CHECK(servo[3] == 1600 && servo[4] == 1600, "passthru ailerons %d %d", servo[3], servo[4]);
+    CHECK(servo[5] == 1550, "passthru rudder %d", servo[5]);
+    CHECK(servo[6] == 1300, "passthru elevator %d", servo[6]);
+
+    f.PASSTHRU_MODE = 0;
+    airplaneMixer();
+    CHECK(servo[3] == 1470 && servo[4] == 1470, "PID ailerons %d %d", servo[3], servo[4]);
+    CHECK(servo[5] == 1440, "PID rudder %d", servo[5]);
+    CHECK(servo[6] == 1540, "PID elevator %d", servo[6]);
+    CHECK(servo[2] == 1500, "flaps not configured but at %d", servo[2]);
+}
+
+// Flaperons move both ailerons the same way in the airframe while roll moves them apart, for either
+// aileron reversed. In output terms: with opposite servoreverse flaperon moves both outputs the same way.
+static void testAirplaneFlaperons(void)
+{
+    static const int8_t reverse[2][2] = { { 1, -1 }, { -1, 1 } };
+    int r;
+
+    for (r = 0; r < 2; r++) {
+        resetConfig();
+        cfg.flaperons = 2;
+        cfg.servoreverse[3] = reverse[r][0];
+        cfg.servoreverse[4] = reverse[r][1];
+        setupMixer(MULTITYPE_AIRPLANE);
+        axisPID[ROLL] = axisPID[PITCH] = axisPID[YAW] = 0;
+
+        rcData[AUX2] = cfg.midrc + 200;
+        airplaneMixer();
+        CHECK(servo[3] == 1500 + 200 * reverse[r][0], "reverse %d: left aileron %d", reverse[r][0], servo[3]);
+        CHECK(servo[4] == 1500 - 200 * reverse[r][1], "reverse %d: right aileron %d", reverse[r][1], servo[4]);
+        CHECK(servo[3] == servo[4], "reverse %d/%d: flaperon outputs %d %d differ", reverse[r][0], reverse[r][1], servo[3], servo[4]);
+
+        rcData[AUX2] = cfg.midrc;
+        axisPID[ROLL] = 100;
+        airplaneMixer();
+        CHECK(servo[3] - 1500 == -(servo[4] - 1500), "reverse %d/%d: roll outputs %d %d not opposite", reverse[r][0], reverse[r][1], servo[3], servo[4]);
+    }
+}
+
+// flapspeed ramps flaps and flaperons by at most that many us per call, 0 moves at once.
+static void testAirplaneFlapSpeed(void)
+{
+    int n;
+
+    resetConfig();
+    cfg.flaps = 1;
+    cfg.flaperons = 1;
+    setupMixer(MULTITYPE_AIRPLANE);
+    axisPID[ROLL] = axisPID[PITCH] = axisPID[YAW] = 0;
+    // start from centered flaps, whatever earlier tests left in the slew state
+    airplaneMixer();
+
+    cfg.flapspeed = 10;
+    rcData[AUX1] = cfg.midrc + 250;
+    airplaneMixer();
+    CHECK(servo[2] == 1510, "first step to %d", servo[2]);
+    CHECK(servo[3] == 1510 && servo[4] == 1490, "flaperon first step %d %d", servo[3], servo[4]);
+    for (n = 1; n < 24; n++)
+        airplaneMixer();
+    CHECK(servo[2] == 1740, "after 24 steps at %d", servo[2]);
+    for (n = 0; n < 5; n++)
+        airplaneMixer();
+    CHECK(servo[2] == 1750, "did not stop at the target but %d", servo[2]);
+    CHECK(servo[3] == 1750 && servo[4] == 1250, "flaperons at %d %d", servo[3], servo[4]);
+
+    cfg.flapspeed = 0;
+    rcData[AUX1] = cfg.midrc - 100;
+    airplaneMixer();
+    CHECK(servo[2] == 1400, "no flapspeed, flaps at %d", servo[2]);
+}
+
+// Trim shifts the middle, the endpoints limit the result whatever trim and reverse did.
+static void testAirplaneEndpoints(void)
+{
+    resetConfig();
+    cfg.servotrim[6] = 30;
+    cfg.servoendpoint_low[6] = 1200;
+    cfg.servoendpoint_high[6] = 1700;
+    cfg.servoreverse[5] = -1;
+    cfg.servoendpoint_low[5] = 1100;
+    cfg.servoendpoint_high[5] = 1900;
+    setupMixer(MULTITYPE_AIRPLANE);
+    axisPID[ROLL] = 0;
+
+    axisPID[PITCH] = 100;
+    axisPID[YAW] = 100;
+    airplaneMixer();
+    CHECK(servo[6] == 1630, "trimmed elevator %d", servo[6]);
+    CHECK(servo[5] == 1400, "reversed rudder %d", servo[5]);
+
+    axisPID[PITCH] = 500;
+    axisPID[YAW] = 500;
+    airplaneMixer();
+    CHECK(servo[6] == 1700, "elevator above its endpoint at %d", servo[6]);
+    CHECK(servo[5] == 1100, "reversed rudder below its endpoint at %d", servo[5]);
+
+    axisPID[PITCH] = -500;
+    axisPID[YAW] = -500;
+    airplaneMixer();
+    CHECK(servo[6] == 1200, "elevator below its endpoint at %d", servo[6]);
+    CHECK(servo[5] == 1900, "reversed rudder above its endpoint at %d", servo[5]);
+}
+
+static void setupHeli(uint8_t type, int16_t phase)
+{
+    int i;
+
+    resetConfig();
+    cfg.heli_swash_phase = phase;
+    cfg.heli_collective_throw = 200;
+    for (i = 0; i < 5; i++) {
+        cfg.heli_pitch_curve[i] = -100 + i * 50;
+        cfg.heli_throttle_curve[i] = i * 25;
+    }
+    setupMixer(type);
+    axisPID[ROLL] = axisPID[PITCH] = axisPID[YAW] = 0;
+}
+
+// 120 CCPM: servos at 300/60/180 degrees plus heli_swash_phase, roll share sin, pitch share cos.
+static void testHeliCcpmGeometry(void)
+{
+    static const int16_t phases[] = { 0, 30, -45 };
+    static const int16_t ccpm[3] = { 300, 60, 180 };
+    int p, i;
+
+    for (p = 0; p < 3; p++) {
+        setupHeli(MULTITYPE_HELI_120_CCPM, phases[p]);
+        for (i = 0; i < 3; i++) {
+            float rad = (ccpm[i] + phases[p]) * M_PI / 180.0f;
+            CHECK(swashMix[i][HELI_COLL] == MIXER_SCALE, "phase %d servo %d: collective %d", phases[p], i, swashMix[i][HELI_COLL]);
+            CHECK(abs(swashMix[i][HELI_ROLL] - sinf(rad) * MIXER_SCALE) <= 1, "phase %d servo %d: roll %d", phases[p], i, swashMix[i][HELI_ROLL]);
+            CHECK(abs(swashMix[i][HELI_PITCH] - cosf(rad) * MIXER_SCALE) <= 1, "phase %d servo %d: pitch %d", phases[p], i, swashMix[i][HELI_PITCH]);
+        }
+    }
+
+    // phase 0: left and right share roll, the rear servo is pitch only
+    setupHeli(MULTITYPE_HELI_120_CCPM, 0);
+    CHECK(swashMix[0][HELI_ROLL] == -swashMix[1][HELI_ROLL] && swashMix[0][HELI_PITCH] == swashMix[1][HELI_PITCH], "left/right not symmetric");
+    CHECK(swashMix[2][HELI_ROLL] == 0 && swashMix[2][HELI_PITCH] == -MIXER_SCALE, "rear servo %d %d", swashMix[2][HELI_ROLL], swashMix[2][HELI_PITCH]);
+}
+
+// Collective alone moves all three swash servos by the same amount, roll and pitch alone leave their average
+// (the collective) where it is.
+static void testHeliCcpmMixing(void)
+{
+    static const int16_t phases[] = { 0, 30 };
+    int p, sum;
+
+    for (p = 0; p < 2; p++) {
+        setupHeli(MULTITYPE_HELI_120_CCPM, phases[p]);
+
+        rcData[THROTTLE] = 2000;
+        heliMixer();
+        CHECK(servo[3] == 1700 && servo[4] == 1700 && servo[6] == 1700, "phase %d: full collective %d %d %d", phases[p], servo[3], servo[4], servo[6]);
+        CHECK(motor[0] == cfg.maxthrottle, "phase %d: full throttle curve at %d", phases[p], motor[0]);
+
+        rcData[THROTTLE] = cfg.mincheck + (2000 - cfg.mincheck) / 2;
+        axisPID[ROLL] = 200;
+        heliMixer();
+        sum = servo[3] + servo[4] + servo[6] - 3 * 1500;
+        CHECK(abs(sum) <= 1, "phase %d: roll changes collective by %d", phases[p], sum);
+        CHECK(servo[3] != 1500 || servo[4] != 1500, "phase %d: roll did not move the swash", phases[p]);
+
+        axisPID[ROLL] = 0;
+        axisPID[PITCH] = -150;
+        heliMixer();
+        sum = servo[3] + servo[4] + servo[6] - 3 * 1500;
+        CHECK(abs(sum) <= 1, "phase %d: pitch changes collective by %d", phases[p], sum);
+    }
+}
+
+// 90 degree swash is mixed mechanically: servo[3] roll, servo[4] collective, servo[6] pitch, nothing else.
+static void testHeli90Deg(void)
+{
+    setupHeli(MULTITYPE_HELI_90_DEG, 0);
+    rcData[THROTTLE] = cfg.mincheck + (2000 - cfg.mincheck) / 2;
+
+    axisPID[ROLL] = 120;
+    heliMixer();
+    CHECK(servo[3] == 1620 && servo[4] == 1500 && servo[6] == 1500, "roll only: %d %d %d", servo[3], servo[4], servo[6]);
+
+    axisPID[ROLL] = 0;
+    axisPID[PITCH] = -80;
+    heliMixer();
+    CHECK(servo[3] == 1500 && servo[4] == 1500 && servo[6] == 1420, "pitch only: %d %d %d", servo[3], servo[4], servo[6]);
+
+    axisPID[PITCH] = 0;
+    rcData[THROTTLE] = 2000;
+    heliMixer();
+    CHECK(servo[3] == 1500 && servo[4] == 1700 && servo[6] == 1500, "collective only: %d %d %d", servo[3], servo[4], servo[6]);
+}
+
+int main(void)
+{
+    testMixerSweep();
+    testMixerAirmode();
+    testMixerPidScaling();
+    testAirplanePassthru();
+    testAirplaneFlaperons();
+    testAirplaneFlapSpeed();
+    testAirplaneEndpoints();
+    testHeliCcpmGeometry();
+    testHeliCcpmMixing();
+    testHeli90Deg();
+    return testDone("mixer");
+}
@@ -0,0 +1,240 @@
+// Host test for pid.c: step response of the floating point rate PID on a simulated airframe axis, against the
+// MultiWii integer PID from mw.c with the same P8/I8/D8, plus a timing comparison of both.
+
+#include <time.h>
+#include "unittest.h"
+#include "mw.c"
+
+// used by mw.c and pid.c
+config_t cfg;
+int16_t gyroData[3];
+int16_t angle[2];
+
+#define GYRO_LSB_DPS    (1998.0f / (32767.0f / 4.0f))   // same as GYRO_DPS in pid.c
+#define PLANT_GAIN      2.0f        // deg/s per axisPID unit at steady state
+#define PLANT_TAU       0.05f       // s, first order lag of motors and airframe
+#define STEP_COMMAND    200         // rcCommand[ROLL] for the step
+#define STEP_TIME       2.0f        // s simulated after the step
+#define MAX_LOOPS       1000
+
+typedef void (*pidFunc)(void);
+
+typedef struct stepResult_t {
+    int loops;
+    float dt;
+    float rate[MAX_LOOPS];          // deg/s, roll rate at the end of every loop
+} stepResult_t;
+
+static void resetPid(uint16_t looptime)
+{
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&f, 0, sizeof(f));
+    // pidMultiWii() divides by P8 of every axis, only ROLL gets dynP8/dynI8/dynD8 below
+    cfg.P8[ROLL] = cfg.P8[PITCH] = cfg.P8[YAW] = 40;
+    cfg.I8[ROLL] = 30;
+    cfg.D8[ROLL] = 23;
+    cfg.pid_output_limit = 500;
+    // the MultiWii rate loop targets rcCommand * 80 / P8 gyro LSB, give the float PID the same stick rate
+    cfg.pid_max_rate = 500.0f * 80 / cfg.P8[ROLL] * GYRO_LSB_DPS + 0.5f;
+    memset(dynP8, 0, sizeof(dynP8));
+    memset(dynI8, 0, sizeof(dynI8));
+    memset(dynD8, 0, sizeof(dynD8));
+    dynP8[ROLL] = cfg.P8[ROLL];
+    dynI8[ROLL] = cfg.I8[ROLL];
+    dynD8[ROLL] = cfg.D8[ROLL];
+    memset(rcCommand, 0, sizeof(rcCommand));
+    memset(gyroData, 0, sizeof(gyroData));
+    cycleTime = looptime;
+}
+
+// a few loops at rest flush the derivative history of the previous run, then the integrators start from zero
+static void settlePid(pidFunc pid)
+{
+    int n;
+
+    for (n = 0; n < 5; n++)
+        pid();
+    pidResetIntegrals();
+    pidFloatReset();
+}
+
+// First order roll rate plant, integrated in 10 steps per loop. The PID sees the gyro sampled at the start of
+// the loop and its output acts until the next one, like on the board.
+static void runStep(pidFunc pid, uint16_t looptime, stepResult_t *result)
+{
+    float rate = 0.0f, dt = looptime * 1e-6f;
+    int n, k;
+
+    resetPid(looptime);
+    settlePid(pid);
+    rcCommand[ROLL] = STEP_COMMAND;
+    result->dt = dt;
+    result->loops = min(STEP_TIME / dt, MAX_LOOPS);
+    for (n = 0; n < result->loops; n++) {
+        gyroData[ROLL] = lrintf(rate / GYRO_LSB_DPS);
+        pid();
+        for (k = 0; k < 10; k++)
+            rate += (PLANT_GAIN * axisPID[ROLL] - rate) / PLANT_TAU * dt / 10;
+        result->rate[n] = rate;
+    }
+}
+
+// roll rate at time t, linear between loops
+static float rateAt(const stepResult_t *result, float t)
+{
+    float pos = t / result->dt - 1;
+    int n = pos;
+
+    if (n < 0)
+        return result->rate[0] * (pos + 1);
+    if (n >= result->loops - 1)
+        return result->rate[result->loops - 1];
+    return result->rate[n] + (pos - n) * (result->rate[n + 1] - result->rate[n]);
+}
+
+static float riseTime(const stepResult_t *result, float target)
+{
+    int n;
+
+    for (n = 0; n < result->loops; n++) {
+        if (result->rate[n] >= 0.9f * target)
+            return (n + 1) * result->dt;
+    }
+    return STEP_TIME;
+}
+
+static float peak(const stepResult_t *result)
+{
+    float highest = 0.0f;
+    int n;
+
+    for (n = 0; n < result->loops; n++)
+        highest = max(highest, result->rate[n]);
+    return highest;
+}
+
+// largest difference between two responses over the whole step, in deg/s
+static float difference(const stepResult_t *a, const stepResult_t *b)
+{
+    float worst = 0.0f, t;
+
+    for (t = 0.0f; t < STEP_TIME; t += 0.001f)
+        worst = max(worst, fabsf(rateAt(a, t) - rateAt(b, t)));
+    return worst;
+}
+
+static stepResult_t floatStep, multiWiiStep;
+
+// With the default ROLL gains the P term alone gets to about 80% of the stick rate on this plant, I takes it the
+// rest of the way without steady state error, D keeps the overshoot down.
+static void testPidStepResponse(void)
+{
+    float target, final;
+
+    runStep(pidFloat, 3500, &floatStep);
+    target = STEP_COMMAND * cfg.pid_max_rate / 500.0f;
+    final = floatStep.rate[floatStep.loops - 1];
+    testPrint("pid float 3500us: 90%% after %.0fms, peak %.1f, final %.1f of %.1f deg/s\n",
+        riseTime(&floatStep, target) * 1000, peak(&floatStep), final, target);
+    CHECK(fabsf(final - target) < 0.02f * target, "final rate %.1f, target %.1f", final, target);
+    CHECK(riseTime(&floatStep, target) < 0.5f, "90%% of the target after %.3fs", riseTime(&floatStep, target));
+    CHECK(peak(&floatStep) < 1.1f * target, "overshoot to %.1f", peak(&floatStep));
+}
+
+// Same P8/I8/D8 at the 3.5ms looptime the MultiWii gains are tuned for give the same response from both
+// controllers, which is what the gain scaling in pid.c promises.
+static void testPidMultiWiiEquivalence(void)
+{
+    float target, apart;
+
+    runStep(pidFloat, 3500, &floatStep);
+    runStep(pidMultiWii, 3500, &multiWiiStep);
+    target = STEP_COMMAND * cfg.pid_max_rate / 500.0f;
+    apart = difference(&floatStep, &multiWiiStep);
+    testPrint("pid float vs MultiWii at 3500us: %.1f deg/s apart at most\n", apart);
+    CHECK(apart < 0.03f * target, "float and MultiWii PID %.1f deg/s apart", apart);
+}
+
+// axisPID[ROLL] after holding an input for a fixed time at the given looptime. With gyro still the error is
+// constant and P + I remain, a constant gyro slope with P and I off leaves D.
+static int16_t holdInput(pidFunc pid, uint16_t looptime, bool slope)
+{
+    int n, loops = 0.2f / (looptime * 1e-6f) + 0.5f;
+
+    resetPid(looptime);
+    settlePid(pid);
+    if (slope) {
+        dynP8[ROLL] = dynI8[ROLL] = 0;
+        for (n = 0; n < loops; n++) {
+            // 2000 deg/s^2
+            gyroData[ROLL] = lrintf(2000.0f * (n + 1) * looptime * 1e-6f / GYRO_LSB_DPS);
+            pid();
+        }
+    } else {
+        rcCommand[ROLL] = 50;
+        for (n = 0; n < loops; n++)
+            pid();
+    }
+    return axisPID[ROLL];
+}
+
+// The float PID integrates and differentiates over cycleTime, so the same input over the same time gives the
+// same output at 2ms and 3.5ms looptime. MultiWii works per loop, its I and D move with the looptime.
+static void testPidLooptime(void)
+{
+    int16_t slow, fast;
+    int slope;
+
+    for (slope = 0; slope <= 1; slope++) {
+        slow = holdInput(pidFloat, 3500, slope);
+        fast = holdInput(pidFloat, 2000, slope);
+        testPrint("pid %s after 0.2s, float: %d at 3500us, %d at 2000us, MultiWii: %d at 3500us, %d at 2000us\n",
+            slope ? "D" : "P+I", slow, fast, holdInput(pidMultiWii, 3500, slope), holdInput(pidMultiWii, 2000, slope));
+        CHECK(slow != 0 && abs(fast - slow) <= max(2, abs(slow) / 50), "%s: %d at 3500us, %d at 2000us", slope ? "D" : "P+I", slow, fast);
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Host time per call of either controller with all three axes active. Only the ratio means anything for the
+// board: the F103 has no FPU, so there the float PID costs more relative to the integer one than here.
+static void benchmarkPid(void)
+{
+    static const pidFunc pids[2] = { pidMultiWii, pidFloat };
+    static const char *names[2] = { "MultiWii", "float" };
+    double start, ns[2];
+    int p, n;
+
+    for (p = 0; p < 2; p++) {
+        resetPid(3500);
+        settlePid(pids[p]);
+        dynP8[PITCH] = dynP8[YAW] = 40;
+        dynI8[PITCH] = dynI8[YAW] = 30;
+        dynD8[PITCH] = 23;
+        start = seconds();
+        for (n = 0; n < 1000000; n++) {
+            rcCommand[n % 3] = n & 0xff;
+            gyroData[n % 3] = (n >> 3) & 0x7f;
+            pids[p]();
+        }
+        ns[p] = (seconds() - start) * 1e9 / n;
+    }
+    for (p = 0; p < 2; p++)
+        testPrint("pid %s: %.1f ns per call on this host\n", names[p], ns[p]);
+    CHECK(ns[1] > 0.0 && ns[0] > 0.0, "timer did not run");
+}
+
+int main(void)
+{
+    testPidStepResponse();
+    testPidMultiWiiEquivalence();
+    testPidLooptime();
+    benchmarkPid();
+    return testDone("pid");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Minimal checks for the host tests. A failed CHECK prints where and why and the test keeps going,
+// testDone() prints the summary and gives the exit code for main().
+// Include this before the firmware sources: printf.h maps printf to the firmware's tfp_printf, so tests
+// print through testPrint() instead.
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static int testChecks = 0;
+static int testFailures = 0;
+
+static inline void testPrint(const char *format, ...)
+{
+    va_list va;
+
+    va_start(va, format);
+    vprintf(format, va);
+    va_end(va);
+}
+
+static inline void testFail(const char *file, int line, const char *cond, const char *format, ...)
+{
+    va_list va;
+
+    testFailures++;
+    printf("%s:%d: check failed: %s: ", file, line, cond);
+    va_start(va, format);
+    vprintf(format, va);
+    va_end(va);
+    printf("\n");
+}
+
+#define CHECK(cond, ...) do {                                       \
+        testChecks++;                                               \
+        if (!(cond))                                                \
+            testFail(__FILE__, __LINE__, #cond, __VA_ARGS__);       \
+    } while (0)
+
+static inline int testDone(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+    return testFailures ? 1 : 0;
+}